@@ -0,0 +1,688 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     AsyncIO.h
+ *
+ * This header implements the asynchronous file I/O of the --async-io mode of
+ *   Azeem_Musa_QuickSort.cpp, which keeps many whole-file reads and writes
+ *   in flight while the calling thread parses and sorts
+ *  - With io_uring, every file is a chain of operations: open, statx (reads
+ *    only), read or write until done, close. The next operation of a file is
+ *    queued when the previous one completes, and all queued operations are
+ *    submitted with the same io_uring_enter call that waits for the next
+ *    completion, so opens and directory creations are batched as well
+ *  - The ring is set up with raw system calls (no liburing). When io_uring
+ *    is unavailable (old kernel, seccomp, kernel.io_uring_disabled) or the
+ *    kernel lacks one of the operations used (probed with
+ *    IORING_REGISTER_PROBE, mkdirat needs Linux 5.15), the same requests
+ *    run as blocking calls on a ThreadPool
+ *  - IoStats counts the operations and system calls made and the time the
+ *    calling thread waited for completions
+ */
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "ThreadPool.h"
+
+// How the requests are run
+enum class IoBackend { uring, threads };
+
+// Work done for the requests of a run
+struct IoStats {
+    std::uint64_t operations = 0;   // opens, stats, reads, writes, closes
+                                    //  and directory creations
+    std::uint64_t syscalls = 0;     // system calls made for them
+    double wait_time = 0;           // ms the caller waited for completions
+};
+
+// A whole-file read or write
+struct IoRequest {
+    std::size_t id = 0;             // caller's tag
+    std::string path;
+    bool write = false;
+    std::vector<char> data;         // contents read, or bytes to write
+    int error = 0;                  // errno of the failed operation, or 0
+};
+
+class AsyncFileIO {
+
+    private:
+        // Operation a slot waits for
+        enum class Stage { idle, open, stat, transfer, close };
+
+        struct Slot {
+            IoRequest request;
+            Stage stage = Stage::idle;
+            int fd = -1;
+            std::size_t done = 0;       // bytes read or written
+            struct statx stx;
+        };
+
+        IoBackend used;
+        unsigned depth;
+        IoStats io_stats;
+        std::deque<IoRequest> waiting;      // not started yet
+        std::deque<IoRequest> finished;     // not returned by next yet
+        std::size_t active = 0;             // started, not finished
+
+        // io_uring state
+        int ring_fd = -1;
+        void *sq_ring = MAP_FAILED;
+        void *cq_ring = MAP_FAILED;
+        std::size_t sq_ring_size = 0;
+        std::size_t cq_ring_size = 0;
+        struct io_uring_sqe *sqes = nullptr;
+        std::size_t sqes_size = 0;
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned *sq_mask = nullptr;
+        unsigned *sq_array = nullptr;
+        unsigned sq_entries = 0;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned *cq_mask = nullptr;
+        struct io_uring_cqe *cqes = nullptr;
+        unsigned local_tail = 0;
+        unsigned unsubmitted = 0;
+        std::vector<Slot> slots;
+        std::vector<std::size_t> free_slots;
+
+        // Thread pool state
+        std::unique_ptr<ThreadPool> pool;
+        TaskGroup group;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        std::uint64_t pool_syscalls = 0;    // guarded by mutex
+        std::uint64_t pool_operations = 0;  // guarded by mutex
+
+        bool setup_ring(const unsigned entries);
+        bool supports_operations();
+        struct io_uring_sqe *get_sqe();
+        int enter(const unsigned min_complete);
+        void start_waiting();
+        void queue_stage(const std::size_t s);
+        void complete(const std::size_t s, const int res);
+        void reap();
+        void run_blocking(IoRequest &request, std::uint64_t &syscalls,
+            std::uint64_t &operations);
+
+        static constexpr std::uint64_t mkdir_tag = ~std::uint64_t(0);
+        static constexpr std::size_t max_transfer = std::size_t(1) << 30;
+
+    public:
+        AsyncFileIO(const IoBackend backend, const unsigned depth);
+        ~AsyncFileIO();
+        AsyncFileIO(const AsyncFileIO &) = delete;
+        AsyncFileIO &operator=(const AsyncFileIO &) = delete;
+
+        IoBackend backend() const;
+        void submit(IoRequest request);
+        bool next(IoRequest &request);
+        int make_directories(const std::vector<std::string> &dirs);
+        IoStats stats();
+};
+
+inline AsyncFileIO::AsyncFileIO(const IoBackend backend,
+    const unsigned depth) : used(backend), depth(std::max(depth, 1u)) {
+    /**
+     * Sets up an io_uring with a slot per request in flight, or the thread
+     *  pool if io_uring was not asked for, cannot be set up or does not
+     *  support every operation used
+     *
+     * Parameters:
+     *      backend (IoBackend) :   uring or threads
+     *      depth (unsigned)    :   most requests in flight
+     */
+    if (used == IoBackend::uring && !setup_ring(this->depth)) {
+        used = IoBackend::threads;
+    }
+    if (used == IoBackend::uring) {
+        slots.resize(this->depth);
+        for (std::size_t s = this->depth; s > 0; s--) {
+            free_slots.push_back(s - 1);
+        }
+    }
+    else {
+        // One thread per request in flight, plus the caller
+        pool = std::make_unique<ThreadPool>(this->depth + 1);
+    }
+}
+
+inline AsyncFileIO::~AsyncFileIO() {
+    /**
+     * Waits for the requests still in flight and releases the ring
+     */
+    if (used == IoBackend::uring) {
+        while (active > 0) {
+            if (enter(1) < 0) {
+                break;
+            }
+            reap();
+        }
+        for (Slot &slot : slots) {
+            if (slot.fd >= 0) {
+                close(slot.fd);
+            }
+        }
+    }
+    else {
+        pool->wait(group);
+    }
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+}
+
+inline bool AsyncFileIO::setup_ring(const unsigned entries) {
+    /**
+     * Creates the ring and maps its submission and completion queues
+     *
+     * Parameters:
+     *      entries (unsigned)  :   submission queue entries
+     *
+     * Returns:
+     *      bool    :   true if io_uring can be used
+     */
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0 || !supports_operations()) {
+        return false;
+    }
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring = sq_ring;
+    }
+    else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            return false;
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqe_map == MAP_FAILED) {
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe *>(sqe_map);
+
+    char *sq = static_cast<char *>(sq_ring);
+    char *cq = static_cast<char *>(cq_ring);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_entries = params.sq_entries;
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    local_tail = *sq_tail;
+    return true;
+}
+
+inline bool AsyncFileIO::supports_operations() {
+    /**
+     * Asks the kernel which operations the ring supports
+     *
+     * Returns:
+     *      bool    :   true if every operation the requests use is supported
+     */
+    constexpr unsigned probe_ops = 256;
+    std::vector<char> buffer(sizeof(struct io_uring_probe)
+        + probe_ops * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe *probe
+        = reinterpret_cast<struct io_uring_probe *>(buffer.data());
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE,
+        probe, probe_ops) < 0) {
+        return false;
+    }
+    for (unsigned op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+        IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_MKDIRAT}) {
+        if (op > probe->last_op
+            || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline struct io_uring_sqe *AsyncFileIO::get_sqe() {
+    /**
+     * Returns:
+     *      (io_uring_sqe *)    :   a cleared submission queue entry, or
+     *                              nullptr if the queue is full
+     */
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (local_tail - head >= sq_entries) {
+        return nullptr;
+    }
+    unsigned index = local_tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    local_tail++;
+    unsubmitted++;
+    io_stats.operations++;
+    return sqe;
+}
+
+inline int AsyncFileIO::enter(const unsigned min_complete) {
+    /**
+     * Submits the queued entries and waits for min_complete completions
+     *
+     * Returns:
+     *      int :   0, or a negative errno if the ring failed
+     */
+    __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+    auto wait_start = std::chrono::steady_clock::now();
+    long ret;
+    do {
+        io_stats.syscalls++;
+        ret = syscall(__NR_io_uring_enter, ring_fd, unsubmitted, min_complete,
+            min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (min_complete > 0) {
+        io_stats.wait_time += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - wait_start).count();
+    }
+    if (ret < 0) {
+        return -errno;
+    }
+    unsubmitted -= std::min<unsigned>(unsubmitted, ret);
+    return 0;
+}
+
+inline void AsyncFileIO::queue_stage(const std::size_t s) {
+    /**
+     * Queues the operation of the current stage of a slot
+     *
+     * Parameters:
+     *      s (size_t)  :   slot index
+     */
+    Slot &slot = slots[s];
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == nullptr) {
+        // Every slot has at most one entry queued, so this cannot happen
+        //  with a ring of depth entries
+        complete(s, -EBUSY);
+        return;
+    }
+    sqe->user_data = s;
+    IoRequest &request = slot.request;
+    switch (slot.stage) {
+        case Stage::open:
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uint64_t>(request.path.c_str());
+            sqe->len = 0644;
+            sqe->open_flags = O_CLOEXEC | (request.write
+                ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+            break;
+        case Stage::stat:
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<std::uint64_t>("");
+            sqe->len = STATX_SIZE;
+            sqe->off = reinterpret_cast<std::uint64_t>(&slot.stx);
+            sqe->statx_flags = AT_EMPTY_PATH;
+            break;
+        case Stage::transfer:
+            sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<std::uint64_t>(
+                request.data.data() + slot.done);
+            sqe->len = static_cast<std::uint32_t>(std::min(max_transfer,
+                request.data.size() - slot.done));
+            sqe->off = slot.done;
+            break;
+        case Stage::close:
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot.fd;
+            break;
+        case Stage::idle:
+            break;
+    }
+}
+
+inline void AsyncFileIO::complete(const std::size_t s, const int res) {
+    /**
+     * Moves a slot to its next stage after an operation completed
+     *
+     * Parameters:
+     *      s (size_t)  :   slot index
+     *      res (int)   :   result of the operation
+     */
+    Slot &slot = slots[s];
+    IoRequest &request = slot.request;
+    if (res < 0 && slot.stage != Stage::close && request.error == 0) {
+        request.error = -res;
+    }
+    switch (slot.stage) {
+        case Stage::open:
+            if (res < 0) {
+                slot.stage = Stage::idle;
+                break;
+            }
+            slot.fd = res;
+            slot.stage = request.write ? Stage::transfer : Stage::stat;
+            if (request.write && request.data.empty()) {
+                slot.stage = Stage::close;
+            }
+            break;
+        case Stage::stat:
+            if (res < 0) {
+                slot.stage = Stage::close;
+                break;
+            }
+            request.data.resize(slot.stx.stx_size);
+            slot.stage = request.data.empty() ? Stage::close
+                : Stage::transfer;
+            break;
+        case Stage::transfer:
+            if (res == 0 && request.error == 0) {
+                request.error = EIO;        // file shrank while read
+            }
+            if (res > 0) {
+                slot.done += res;
+            }
+            if (res <= 0 || slot.done == request.data.size()) {
+                slot.stage = Stage::close;
+            }
+            break;
+        case Stage::close:
+            if (res < 0 && request.error == 0) {
+                request.error = -res;
+            }
+            slot.fd = -1;
+            slot.stage = Stage::idle;
+            break;
+        case Stage::idle:
+            break;
+    }
+    if (slot.stage == Stage::idle) {
+        finished.push_back(std::move(request));
+        free_slots.push_back(s);
+        active--;
+    }
+    else {
+        queue_stage(s);
+    }
+}
+
+inline void AsyncFileIO::reap() {
+    /**
+     * Handles every completion in the completion queue
+     */
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe &cqe = cqes[head & *cq_mask];
+        std::uint64_t tag = cqe.user_data;
+        int res = cqe.res;
+        head++;
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        if (tag != mkdir_tag) {
+            complete(static_cast<std::size_t>(tag), res);
+        }
+        tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+inline void AsyncFileIO::start_waiting() {
+    /**
+     * Starts waiting requests while slots are free
+     */
+    while (!waiting.empty() && !free_slots.empty()) {
+        std::size_t s = free_slots.back();
+        free_slots.pop_back();
+        slots[s].request = std::move(waiting.front());
+        waiting.pop_front();
+        slots[s].stage = Stage::open;
+        slots[s].done = 0;
+        active++;
+        queue_stage(s);
+    }
+}
+
+inline void AsyncFileIO::run_blocking(IoRequest &request,
+    std::uint64_t &syscalls, std::uint64_t &operations) {
+    /**
+     * Runs a request with blocking calls on a pool thread
+     *
+     * Parameters:
+     *      request (IoRequest &)   :   request to run
+     *      syscalls (uint64_t &)   :   incremented per system call
+     *      operations (uint64_t &) :   incremented per operation
+     */
+    syscalls++;
+    operations++;
+    int fd = open(request.path.c_str(), O_CLOEXEC | (request.write
+        ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY), 0644);
+    if (fd < 0) {
+        request.error = errno;
+        return;
+    }
+    if (!request.write) {
+        syscalls++;
+        operations++;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            request.error = errno;
+        }
+        else {
+            request.data.resize(st.st_size);
+        }
+    }
+    std::size_t done = 0;
+    operations += (request.error == 0 && !request.data.empty());
+    while (request.error == 0 && done < request.data.size()) {
+        syscalls++;
+        ssize_t n = request.write
+            ? pwrite(fd, request.data.data() + done,
+                std::min(max_transfer, request.data.size() - done), done)
+            : pread(fd, request.data.data() + done,
+                std::min(max_transfer, request.data.size() - done), done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            request.error = (n < 0) ? errno : EIO;
+            break;
+        }
+        done += n;
+    }
+    syscalls++;
+    operations++;
+    if (close(fd) != 0 && request.error == 0) {
+        request.error = errno;
+    }
+}
+
+inline IoBackend AsyncFileIO::backend() const {
+    /**
+     * Returns:
+     *      IoBackend   :   uring, or threads if io_uring was not available
+     */
+    return used;
+}
+
+inline void AsyncFileIO::submit(IoRequest request) {
+    /**
+     * Starts a request, or queues it until one of the depth slots is free.
+     *  A read request needs only its path, a write request its path and
+     *  data
+     *
+     * Parameters:
+     *      request (IoRequest) :   request to run
+     */
+    if (used == IoBackend::uring) {
+        waiting.push_back(std::move(request));
+        start_waiting();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    active++;
+    auto task = std::make_shared<IoRequest>(std::move(request));
+    pool->run(group, [this, task]() {
+        std::uint64_t syscalls = 0;
+        std::uint64_t operations = 0;
+        run_blocking(*task, syscalls, operations);
+        std::lock_guard<std::mutex> lock(mutex);
+        pool_syscalls += syscalls;
+        pool_operations += operations;
+        finished.push_back(std::move(*task));
+        done_cv.notify_one();
+    });
+}
+
+inline bool AsyncFileIO::next(IoRequest &request) {
+    /**
+     * Waits for the next request to finish. Operations queued meanwhile are
+     *  submitted before returning, so they run while the caller works
+     *
+     * Parameters:
+     *      request (IoRequest &)   :   set to the finished request
+     *
+     * Returns:
+     *      bool    :   true if a request finished, false if none is left
+     */
+    if (used == IoBackend::threads) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (finished.empty() && active == 0) {
+            return false;
+        }
+        auto wait_start = std::chrono::steady_clock::now();
+        done_cv.wait(lock, [this]() { return !finished.empty(); });
+        io_stats.wait_time += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - wait_start).count();
+        request = std::move(finished.front());
+        finished.pop_front();
+        active--;
+        return true;
+    }
+
+    reap();
+    while (finished.empty() && active > 0) {
+        if (enter(1) < 0) {
+            return false;
+        }
+        reap();
+        start_waiting();
+    }
+    if (unsubmitted > 0) {
+        enter(0);
+    }
+    if (finished.empty()) {
+        return false;
+    }
+    request = std::move(finished.front());
+    finished.pop_front();
+    start_waiting();
+    return true;
+}
+
+inline int AsyncFileIO::make_directories(const std::vector<std::string> &dirs) {
+    /**
+     * Creates directories whose parents exist, submitted together. Existing
+     *  directories are not an error
+     *
+     * Parameters:
+     *      dirs (vector<string>)   :   directories to create
+     *
+     * Returns:
+     *      int :   returns 1 if every directory exists afterwards, 0 if not
+     */
+    if (used == IoBackend::threads) {
+        int ret = 1;
+        for (const std::string &dir : dirs) {
+            io_stats.syscalls++;
+            io_stats.operations++;
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+                ret = 0;
+            }
+        }
+        return ret;
+    }
+    for (std::size_t i = 0; i < dirs.size(); ) {
+        unsigned batch = 0;
+        for (; i < dirs.size(); i++, batch++) {
+            struct io_uring_sqe *sqe = get_sqe();
+            if (sqe == nullptr) {
+                break;
+            }
+            sqe->opcode = IORING_OP_MKDIRAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uint64_t>(dirs[i].c_str());
+            sqe->len = 0755;
+            sqe->user_data = mkdir_tag;
+        }
+        if (enter(batch) < 0) {
+            return 0;
+        }
+        reap();
+    }
+    // Results are not tied to a directory, so check them afterwards
+    for (const std::string &dir : dirs) {
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+inline IoStats AsyncFileIO::stats() {
+    /**
+     * Returns:
+     *      IoStats :   operations, system calls and wait time so far
+     */
+    IoStats stats = io_stats;
+    if (used == IoBackend::threads) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.syscalls += pool_syscalls;
+        stats.operations += pool_operations;
+    }
+    return stats;
+}
+
+#endif  // ASYNC_IO_H
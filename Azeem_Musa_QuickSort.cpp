@@ -16,12 +16,181 @@
  *  - Will find the average execution for each input size and save it in a file
  * 
  * 
- * Usage: ./Azeem_Musa_QuickSort
+ * Usage: ./Azeem_Musa_QuickSort [--type=double|float|int64|uint32]
+ *                               [--engine=classic,hybrid,three_way,block,simd,
+ *                                         parallel,radix,merge,auto]
+ *                               [--simd=auto|avx512|avx2|scalar]
+ *                               [--radix-bits=8|11] [--no-presort]
+ *                               [--total-order] [--nan=first|last|drop]
+ *                               [--threads=N] [--scaling]
+ *                               [--batch] [--readers=N] [--sorters=N]
+ *                               [--writers=N] [--queue-depth=N]
+ *                               [--write-mode=buffered|writev|direct]
+ *                               [--output-format=ascii|binary]
+ *                               [--external] [--memory-budget=MiB]
+ *                               [--stream] [--payload] [--select]
+ *                               [--arena] [--seed=N]
+ *                               [--warmup=N] [--reps=N] [--cache=DIR]
+ *                               [--async-io[=uring|threads]] [--io-depth=N]
  *  
+ * Options:
+ *  --type      :   Key type the input values are parsed and sorted as
+ *                  (default: double). Each key type is its own instantiation
+ *                  of the QuickSort template, so values are never widened
+ *  --engine    :   Comma separated list of sort engines to time on every
+ *                  input file (default: classic)
+ *                   - classic : recursive quick sort with random pivots
+ *                   - hybrid  : introsort - median-of-3/ninther pivots,
+ *                               insertion sort for small subarrays and a
+ *                               heap sort fallback past 2*log2(n) levels.
+ *                               Switches to three way partitioning when
+ *                               the pivot sample contains duplicates
+ *                   - three_way : hybrid engine that always uses Bentley-
+ *                               McIlroy three way partitioning, so values
+ *                               equal to the pivot are never recursed on
+ *                   - block     : hybrid engine with a branchless block
+ *                               partition (BlockQuicksort) that buffers
+ *                               comparison results and swaps in bulk
+ *                   - simd      : hybrid engine with AVX-512/AVX2 vector
+ *                               partitioning and sorting networks for
+ *                               small subarrays (see SimdPartition.h)
+ *                   - parallel  : hybrid engine on a work-stealing thread
+ *                               pool (see ThreadPool.h). Large partitions
+ *                               are split across threads and subarrays
+ *                               above a grain size become tasks
+ *                   - radix     : LSD radix sort (see RadixSort.h) on keys
+ *                               mapped to unsigned integers. Passes whose
+ *                               digit is the same for every key are
+ *                               skipped
+ *                   - merge     : stable parallel merge sort (see
+ *                               MergeSort.h). Values that compare equal
+ *                               keep their input order, so argsort
+ *                               indices of equal keys stay ascending
+ *                   - auto      : picks the radix or simd engine from
+ *                               the key type and input size: radix for
+ *                               integer keys from 1024 values and for
+ *                               floating point keys from 16384 values
+ *                               when AVX-512 is not available, simd
+ *                               otherwise
+ *  --simd      :   Widest instruction set the simd engine may use
+ *                  (default: auto - the widest one the CPU supports).
+ *                  Key types without vector kernels and CPUs without AVX2
+ *                  use the scalar block partition
+ *  --radix-bits:   Bits per digit of the radix engine (default: 11 for
+ *                  8-byte keys with at least 2^20 values, 8 otherwise)
+ *  --no-presort:   Skip the presortedness scan. By default every engine
+ *                  except classic first scans the input for natural runs
+ *                  (ascending, or descending runs which are reversed in
+ *                  place). Sorted input returns at once, and
+ *                  input made of at most 16 runs is merged instead of
+ *                  partitioned. The scan stops at the 17th run, so it costs
+ *                  little on random input
+ *  --total-order
+ *              :   Sort double and float keys in IEEE 754 totalOrder: 
+ *                  -inf < negative values < -0.0 < 0.0 < positive values 
+ *                  < inf. The values are mapped to unsigned integer keys 
+ *                  once (see TotalOrder.h), the keys are sorted with the 
+ *                  selected engine and mapped back, so NaNs never reach a
+ *                  comparison. Ignored for integer key types
+ *  --nan       :   Where the totalOrder mode puts NaNs: first, last or 
+ *                  drop (default: last). Kept NaNs stay in input order.
+ *                  Implies --total-order
+ *  --threads   :   Number of threads used by the parallel and merge engines
+ *                  (default: number of hardware threads)
+ *  --scaling   :   Also time the parallel engine with 1, 2, 4, ... and N 
+ *                  threads and write the speedups to Azeem_Musa_scaling.txt
+ *  --batch     :   Process files in a pipeline instead of one at a time.
+ *                  Reader threads parse files, sorter threads (each with
+ *                  its own QuickSort) sort them and writer threads write the
+ *                  sorted output. The stages are connected by bounded queues
+ *                  so at most queue-depth files wait between two stages
+ *  --readers, --sorters, --writers
+ *              :   Threads per pipeline stage (default: 1, threads, 1).
+ *                  Sorters default to 1 when the parallel or merge engine
+ *                  or --scaling is selected, as those sort on all threads
+ *  --queue-depth
+ *              :   Capacity of each pipeline queue (default: 2 * sorters)
+ *  --write-mode:   How sorted files are written (default: buffered)
+ *                   - buffered : values are formatted into a reusable 1 MiB
+ *                                buffer that is written with one call per chunk
+ *                   - writev   : all chunks are formatted first and written
+ *                                with gathered writev calls
+ *                   - direct   : chunks are written with O_DIRECT, bypassing
+ *                                the page cache (falls back to buffered when
+ *                                the file system does not support it)
+ *                  ASCII output only
+ *  --output-format
+ *              :   Format of the sorted files (default: ascii). Binary files
+ *                  hold the values of the key type (see BinaryFormat.h)
+ *  --external  :   Sort files that may not fit in memory. Each file is read
+ *                  in chunks of the memory budget, every chunk is sorted
+ *                  with the first selected engine and written to a
+ *                  temporary run file next to the sorted file, and the runs
+ *                  are merged with a loser tree (see ExternalMerge.h).
+ *                  Timings are reported for the "external" engine and
+ *                  --batch is ignored
+ *  --memory-budget
+ *              :   Memory in MiB used by the external sort (default: 256).
+ *                  The parallel, radix, merge and auto engines sort chunks
+ *                  of half the budget since their buffer needs the other 
+ *                  half
+ *  --stream    :   Sort the values read from stdin and write them to stdout
+ *                  instead of asking for input directories. Runs of the
+ *                  input are sorted with the first selected engine while
+ *                  the rest is still arriving and are merged into stdout as
+ *                  soon as the input ends. The number of values, time to
+ *                  first output, total time and peak memory are reported on
+ *                  stderr. Output is ASCII
+ *  --payload   :   Also time, with the first selected engine, an argsort
+ *                  with 32-bit and 64-bit indices (argsort-u32/u64) and a
+ *                  sort of the values with a 64-bit payload per value, done
+ *                  by sorting packed (key, payload) records (payload-packed)
+ *                  or by argsorting and gathering (payload-indices)
+ *  --select    :   Also time, with the first selected engine, selecting the
+ *                  median (select-median), the 1/5/25/50/75/95/99th
+ *                  percentiles in one pass (select-percentiles) and sorting
+ *                  the 100 smallest values (top-100)
+ *  --seed      :   Seed of the pivot generator of the classic engine
+ *                  (default: random, printed at the start of the run).
+ *                  Every sort restarts the generator from the seed, so a
+ *                  seed replays the same pivots for the same input
+ *  --arena     :   Reuse memory across files (see BufferPool.h). Arrays
+ *                  keep their capacity from one file to the next and grow
+ *                  by at least half, the batch pipeline recycles the arrays
+ *                  of written files, and arrays of 4 MiB or more are 
+ *                  advised to use transparent huge pages
+ *  --warmup    :   Untimed sorts of every file with each engine before it is
+ *                  timed, so caches, page tables and branch predictors are
+ *                  warm (default: 0)
+ *  --reps      :   Timed sorts of every file with each engine (default: 1).
+ *                  Every repetition sorts a fresh copy of the input and is
+ *                  one sample of the benchmark statistics. The external sort
+ *                  is timed once per file
+ *  --cache     :   Directory of the sorted output cache (see SortCache.h).
+ *                  Every input file is hashed with XXH64, or recognized as
+ *                  unchanged by its size, inode, mtime and ctime. Files whose
+ *                  sorted output is in the cache are hard linked (or 
+ *                  reflinked or copied) into the output directory instead 
+ *                  of being read, sorted and written, and have no timings.
+ *                  Other files are sorted and a reflink or copy of their
+ *                  output is added. The
+ *                  key type, output format and NaN policy are part of the
+ *                  key
+ *  --async-io  :   Read and write the files with asynchronous I/O (see
+ *                  AsyncIO.h): up to io-depth files are read or written
+ *                  while the engines sort, and the output directories are
+ *                  created in one batch. Uses io_uring (default), or blocking
+ *                  calls on a thread pool with =threads or when io_uring is
+ *                  not available or lacks an operation used. Ignored with
+ *                  --batch and --external
+ *  --io-depth  :   Files read or written at once with --async-io 
+ *                  (default: 64)
  * 
  * Input Format:
  *  - Input file should be an ASCII file that contains a list of unsorted
- *    floating-point numbers separated by a blank space
+ *    floating-point numbers separated by a blank space, or a binary file
+ *    (see BinaryFormat.h). Binary files are recognized by their header and
+ *    are converted to the key type if they store another type
  *  - Input directories should contain n input files, each containing the same
  *    number of values
  * 
@@ -46,16 +215,66 @@
  *    where X, Y, ... are the input directories and files 0 to n are 
  *    the files within them
  *  - Each "sorted" output file is an ASCII file containing a list of sorted 
- *    floating-point numbers seperated by a blank space
+ *    floating-point numbers seperated by a blank space. Values are written in
+ *    their shortest form that parses back to exactly the same value.
+ *    With --output-format=binary it is a binary file instead
  *  - Each "execution-time" output file is an ASCII file containing the 
  *    execution time in milliseconds taken to run the quick sort algorithm
  *    for that file
  *  - Azeem_Musa_averageExecutionTime.txt contains the average execution time
  *    for all of the input files combined. It is a tab seperated file with the format:
- *          [Input Size    Average Execution Time (ms)]
+ *          [Input Size    Engine    Average Execution Time (ms)    Cycles/Element]
  *  - Azeem_Musa_executionTime.txt contains the execution time for all of the input 
  *    files combined. It is a tab seperated file with the format:
- *          [Input Size    Execution Time (ms)]
+ *          [Input Size    Engine    Execution Time (ms)    Cycles/Element]
+ *  - Cycles/Element is measured with the time stamp counter on x86 and is
+ *    the number of reference cycles spent per sorted value
+ *  - Built with make instrument=1 (see Instrumentation.h), both files have
+ *    the extra columns:
+ *          [Cycles    Instructions    Branch Misses    L1D Misses
+ *           LLC Misses    Comparisons    Swaps    Partitions    Max Depth
+ *           Imbalance]
+ *    and the rows of the "read" and "write" phases of every file next to
+ *    the rows of the engines. The hardware events are those of the thread
+ *    that ran the phase and are n/a when perf_event_open does not allow
+ *    them. Imbalance is the share of the values of the partitioned
+ *    subarrays that went to the larger side
+ *  - Azeem_Musa_parseThroughput.txt contains the time spent parsing the input
+ *    files of each input size, measured separately from the sort. It is a tab
+ *    seperated file with the format:
+ *          [Input Size    Files    Size (MB)    Parse Time (ms)    Throughput (MB/s)]
+ *  - Azeem_Musa_scaling.txt (--scaling only) contains the average execution
+ *    time of the parallel engine for each thread count and its speedup over
+ *    one thread. It is a tab seperated file with the format:
+ *          [Input Size    Threads    Average Execution Time (ms)    Speedup]
+ *  - Azeem_Musa_benchmark.csv and Azeem_Musa_benchmark.json contain the
+ *    statistics of the samples (files times repetitions) of each input size
+ *    and engine: number of samples, mean, median, 95th percentile and
+ *    standard deviation of the execution time in milliseconds, the 95%
+ *    confidence interval of the mean (Student's t) and the median
+ *    cycles per element. The CSV file has the columns:
+ *          [input_size,engine,samples,mean_ms,median_ms,p95_ms,stddev_ms,
+ *           ci95_low_ms,ci95_high_ms,median_cycles_per_element]
+ *    and the JSON file holds the same fields for each input size and engine
+ *    in its "results" array, along with the warmup, reps and seed of the run
+ *  - Azeem_Musa_cache.txt (--cache only) contains the cache lookups of each
+ *    input size: hits, misses, files recognized without hashing and the 
+ *    size and time of the hashed files. It is a tab seperated file with the
+ *    format:
+ *          [Input Size    Files    Hits    Misses    Hit Rate (%)    
+ *           Unchanged    Hashed (MB)    Hash Time (ms)]
+ *  - Azeem_Musa_io.txt (--async-io only) contains the I/O of the run: the 
+ *    backend, the operations and system calls made, the time spent waiting 
+ *    for I/O and the time spent sorting, measured separately. It is a tab
+ *    seperated file with the format:
+ *          [Backend    Files    Operations    Syscalls    Syscalls/File
+ *           I/O Wait (ms)    Sort Time (ms)    Wall Time (ms)]
+ *  - Azeem_Musa_allocations.txt contains the heap allocations made while the
+ *    files were read, sorted and written, with and without --arena. 
+ *    Allocations are counted in builds with make instrument=1 only and are
+ *    n/a otherwise. It is a tab seperated file with the format:
+ *          [Mode    Files    Allocations    Allocated (MB)    
+ *           Allocations/File    Huge Page Buffers    Huge Pages (MB)]
  */
 
 #include <iostream>
@@ -70,54 +289,823 @@
 #include <chrono>
 #include <ctime>
 #include <map>
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <memory>
+#include <atomic>
+#include <thread>
+
+#include <charconv>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#include <new>
+
+#include "SimdPartition.h"
+#include "ThreadPool.h"
+#include "BoundedQueue.h"
+#include "BinaryFormat.h"
+#include "TextFormat.h"
+#include "ExternalMerge.h"
+#include "RadixSort.h"
+#include "MergeSort.h"
+#include "TotalOrder.h"
+#include "SortCache.h"
+#include "AsyncIO.h"
+#include "BufferPool.h"
+#include "Random.h"
+#include "Instrumentation.h"
 
 namespace fs = std::filesystem;
 
+// Count every heap allocation for Azeem_Musa_allocations.txt, in builds
+//  with QUICKSORT_INSTRUMENT only: the counters are shared by all threads,
+//  so every allocation would otherwise pay for two contended atomics
+// The replacements are not inlined, so the compiler never pairs a new
+//  expression with the free call inside them
+#ifdef QUICKSORT_INSTRUMENT
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, 
+    std::size_t) noexcept {
+    std::free(p);
+}
+#endif  // QUICKSORT_INSTRUMENT
+
+
+// Key types that can be selected with --type
+enum class KeyType { float64, float32, int64, uint32 };
+
+// Output strategies that can be selected with --write-mode
+enum class WriteMode { buffered, writev, direct };
+
+// Ways to sort keys together with a payload array
+enum class PayloadSort { packed, indices };
+
+// Sort engines that can be selected with --engine
+enum class Engine { 
+    classic, hybrid, three_way, block, simd, parallel, radix, merge, 
+    auto_select 
+};
+
+const std::map<std::string, Engine> engine_names = {
+    {"classic", Engine::classic},
+    {"hybrid", Engine::hybrid},
+    {"three_way", Engine::three_way},
+    {"block", Engine::block},
+    {"simd", Engine::simd},
+    {"parallel", Engine::parallel},
+    {"radix", Engine::radix},
+    {"merge", Engine::merge},
+    {"auto", Engine::auto_select}
+};
+
+struct Options {
+    KeyType key_type = KeyType::float64;
+    std::vector<Engine> engines = {Engine::classic};
+    SimdLevel simd_level = detect_simd_level();
+    unsigned radix_bits = 0;    // 0 = by key size and input size
+    bool presort = true;
+    bool total_order = false;
+    NanPolicy nan_policy = NanPolicy::last;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool scaling = false;
+    bool batch = false;
+    unsigned readers = 1;
+    unsigned sorters = 0;       // 0 = same as threads
+    unsigned writers = 1;
+    unsigned queue_depth = 0;   // 0 = 2 * sorters
+    WriteMode write_mode = WriteMode::buffered;
+    FileFormat output_format = FileFormat::ascii;
+    bool external = false;
+    bool stream = false;
+    bool payload = false;
+    bool select = false;
+    bool arena = false;
+    std::uint64_t seed = random_seed();
+    unsigned warmup = 0;        // untimed sorts per file and engine
+    unsigned reps = 1;          // timed sorts per file and engine
+    std::size_t memory_budget = std::size_t(256) << 20;   // bytes
+    std::string cache_dir;      // empty = no sorted output cache
+    bool async_io = false;
+    IoBackend io_backend = IoBackend::uring;
+    unsigned io_depth = 64;     // files read or written at once
+};
+
+// Measurements of a single sort
+struct Timing {
+    double exe_time;            // execution time (ms)
+    double cycles_per_element;  // cycle counter ticks per sorted value
+    PhaseCounters counters;     // hardware and algorithmic counters, all 0
+                                //  unless built with QUICKSORT_INSTRUMENT
+};
+
+// Statistics of the timings of one input size and engine
+struct BenchmarkStats {
+    std::size_t samples = 0;
+    double mean = 0;            // ms
+    double median = 0;          // ms
+    double p95 = 0;             // ms
+    double stddev = 0;          // ms, sample standard deviation
+    double ci_low = 0;          // ms, 95% confidence interval of the mean
+    double ci_high = 0;         // ms
+    double median_cycles = 0;   // cycles per element
+};
+
+// map of input size to the timings of each file for each engine
+//  (.first = input size, .second = map of engine name to timings)
+using ExeTimes = std::map<int, std::map<std::string, std::vector<Timing>>>;
+
+// Time spent parsing input files
+struct ParseTiming {
+    std::size_t files = 0;
+    double bytes = 0;
+    double parse_time = 0;      // ms
+};
+
+// map of input size to the parse timings of all of its files
+using ParseTimes = std::map<int, ParseTiming>;
+
+// Measurements of a streaming sort
+struct StreamStats {
+    std::size_t values = 0;
+    std::size_t runs = 0;
+    double first_output = 0;    // ms from start to the first output
+    double after_input = 0;     // ms from end of input to the first output
+    double total = 0;           // ms from start to the last output
+};
+
+// Measurements of the asynchronous I/O of a run
+struct AsyncTiming {
+    IoBackend backend = IoBackend::uring;
+    std::size_t files = 0;
+    IoStats io;
+    double sort_time = 0;       // ms the engines took
+    double wall_time = 0;       // ms from the first read to the last write
+};
+
+// Thread pools for the parallel engine keyed by their thread count
+using ThreadPools = std::map<unsigned, std::unique_ptr<ThreadPool>>;
 
+// An input file moving through the batch pipeline
+template <typename T>
+struct FileJob {
+    std::string in_path;
+    std::string sorted_path;
+    int input_size;
+    std::vector<T> values;
+    bool read_ok;
+    std::string cache_key;      // key to cache the sorted file under, if any
+};
+
+int parse_args(int argc, char **argv, Options &opts);
+std::string engine_name(const Engine engine);
 std::map<std::string,int> get_dirs_from_user();
-int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs);
+template <typename T>
+int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs,
+    const Options &opts);
+template <typename T, typename Q>
+void time_engines(Q &q, const std::vector<T> &input, const Options &opts,
+    ThreadPools &pools, std::map<std::string, std::vector<Timing>> &times);
+template <typename Q, typename Run>
+void time_repeated(Q &q, const Options &opts, std::vector<Timing> &times,
+    Run run);
+template <typename Q>
+void record_read(const Q &q, std::map<std::string, std::vector<Timing>> &times);
+template <typename Q>
+int write_recorded(const Q &q, const std::string &path,
+    std::map<std::string, std::vector<Timing>> &times);
+template <typename T>
+int run_batch_pipeline(std::vector<FileJob<T>> &jobs, const Options &opts,
+    ThreadPools &pools, ExeTimes &exe_times, ParseTimes &parse_times,
+    SortCache *cache);
+template <typename T, typename Q>
+int run_async_pipeline(Q &q, std::vector<FileJob<T>> &jobs, 
+    const Options &opts, ThreadPools &pools, ExeTimes &exe_times, 
+    ParseTimes &parse_times, SortCache *cache, AsyncFileIO &io,
+    AsyncTiming &timing);
+template <typename T>
+int run_stream_sort(const Options &opts);
+int save_parse_throughput(const std::string out_dir, 
+    const ParseTimes &parse_times);
+std::string cache_tag(const Options &opts);
+int save_cache_stats(const std::string out_dir, 
+    const std::map<int, CacheStats> &cache_stats);
+int save_io_stats(const std::string out_dir, const AsyncTiming &timing);
 int find_average_and_save_times(const std::string out_dir, 
-    const std::map<int, std::vector<double>> &exe_times);
+    const ExeTimes &exe_times);
+BenchmarkStats summarize_timings(const std::vector<Timing> &timings);
+void write_counter_header(std::ostream &out);
+void write_counters(std::ostream &out, const PhaseCounters &counters);
+PhaseCounters average_counters(const std::vector<Timing> &timings);
+double percentile(const std::vector<double> &sorted, const double p);
+int save_benchmark_stats(const std::string out_dir, const ExeTimes &exe_times,
+    const Options &opts);
+int save_scaling_table(const std::string out_dir, const ExeTimes &exe_times,
+    const unsigned max_threads);
+int save_allocation_stats(const std::string out_dir, 
+    const AllocationStats &stats, const std::size_t files, const bool arena);
+std::uint64_t read_cycle_counter();
+
+template <typename Key, typename Payload>
+struct Record {
+    /**
+     * A key/payload pair sorted by its key only
+     */
+    Key key;
+    Payload payload;
+};
+
+template <typename R, typename Compare = std::less<>>
+struct KeyLess {
+    /**
+     * Comparator that orders records by their key
+     */
+    Compare comp = Compare();
+    constexpr bool operator()(const R &a, const R &b) const {
+        return comp(a.key, b.key);
+    }
+};
 
+template <typename T, typename Compare = std::less<T>,
+    typename Index = std::ptrdiff_t>
 class QuickSort {
+    /**
+     * Sorts an array of T in ascending order according to Compare
+     * 
+     * Template Parameters:
+     *  T       :   Element type (arithmetic key or key/payload record)
+     *  Compare :   Strict weak ordering on T (stateless functors are inlined)
+     *  Index   :   Signed integer type used for subarray indices
+     */
+
+    static_assert(std::is_integral_v<Index> && std::is_signed_v<Index>,
+        "QuickSort Index must be a signed integer type");
 
     private:
-        std::vector<double> A;
-        std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
-        std::chrono::time_point<std::chrono::high_resolution_clock> end_time;
-
-        int hoarse_partition(const int l, const int r);
-        int quick_sort(const int l, const int r);
-        void swap(const int i, const int j);
-        int generate_random_int(const int lower, const int upper);
+        std::vector<T> A;
+#ifdef QUICKSORT_INSTRUMENT
+        mutable SortCounters counters;
+        CountingCompare<Compare> comp;  // counts into counters.comparisons
+#else
+        Compare comp;
+#endif
+        PhaseCounters sort_counters;    // counters of the last timed sort
+        PhaseCounters read_counters;    // counters of the last read_file
+        mutable PhaseCounters write_counters;
+        int depth_start;            // depth limit of the running sort, the
+                                    //  partition level is depth_start minus
+                                    //  the depth limit left
+        std::chrono::time_point<std::chrono::steady_clock> start_time;
+        std::chrono::time_point<std::chrono::steady_clock> end_time;
+        std::uint64_t start_cycles;
+        std::uint64_t end_cycles;
+        double parse_time;          // ms spent parsing the last file
+        std::size_t parse_bytes;    // size of the last file
+        std::size_t timed_values;   // values sorted by the last timed sort
+
+        // Output formatting
+        static constexpr std::size_t write_chunk_size = 1 << 20;
+        // External sort: input block size and smallest merge buffer
+        static constexpr std::size_t external_block_size = 1 << 22;
+        static constexpr std::size_t external_min_buffer = 1 << 16;
+        // Streaming: values per sorted run and bytes per read call
+        static constexpr std::size_t stream_run_size = 1 << 16;
+        static constexpr std::size_t stream_block_size = 1 << 16;
+        static constexpr std::size_t direct_alignment = 4096;
+        WriteMode write_mode;
+        FileFormat output_format;
+        mutable std::vector<std::vector<char>> write_chunks;
+
+        Engine engine;
+        SimdLevel simd_level;
+        ThreadPool *pool;           // Threads of the parallel and merge 
+                                    //  engines
+        std::vector<T> scratch;     // Parallel partition, radix and merge 
+                                    //  buffer
+        unsigned radix_bits;        // Radix digit width, 0 = automatic
+        bool presort;               // Scan for natural runs before sorting
+        bool total_order;           // Sort floating point keys in totalOrder
+        NanPolicy nan_policy;       // Where totalOrder puts NaNs
+        std::vector<radix_bits_t<T>> total_keys;    // totalOrder keys
+        // Sorts total_keys, kept with its buffers between sorts
+        std::unique_ptr<QuickSort<radix_bits_t<T>, std::less<radix_bits_t<T>>,
+            Index>> key_sorter;
+        bool arena;                 // Keep buffer capacity across arrays
+        WyRand rng;                 // Pivot generator of the classic engine
+        std::uint64_t seed;         // Seed rng restarts from on every sort
+
+        // Hybrid engine tuning
+        static constexpr Index insertion_sort_threshold = 24;
+        static constexpr Index ninther_threshold = 128;
+        static constexpr Index partition_block_size = 64;
+
+        // Parallel engine tuning
+        static constexpr Index parallel_grain = 1 << 14;
+        static constexpr Index parallel_partition_threshold = 1 << 18;
+
+        // Most natural runs that are merged instead of partitioned
+        static constexpr std::size_t presort_max_runs = 16;
+
+        // Radix engine tuning
+        static constexpr Index radix_auto_int_threshold = 1 << 10;
+        static constexpr Index radix_auto_float_threshold = 1 << 14;
+        static constexpr Index radix_wide_digit_threshold = 1 << 20;
+
+        const char *parse_buffer(const char *first, const char *last,
+            const std::size_t max_values = SIZE_MAX);
+        int load_binary(const char *first, const std::size_t size);
+        void load_bytes(const char *first, const std::size_t size);
+        int write_formatted(const std::string &filename) const;
+        int write_run(const std::string path) const;
+        template <typename OnFull>
+        int parse_text_stream(const int fd, std::vector<char> &block, 
+            std::size_t have, bool eof, const std::size_t chunk_values,
+            OnFull on_full);
+        int merge_runs(const std::vector<std::string> &runs, 
+            const std::string out_path, const std::size_t memory_budget);
+        Index hoarse_partition(const Index l, const Index r);
+        int quick_sort(const Index l, const Index r, const int depth = 1);
+        void swap(const Index i, const Index j);
+        void swap_values(T &a, T &b);
+        void count_partition(const Index l, const Index r, const Index lt,
+            const Index gt, const int depth);
+        Index generate_random_int(const Index lower, const Index upper);
+
+        void intro_sort(Index l, Index r, int depth_limit);
+        void partition_step(const Index l, const Index r, Index &lt, 
+            Index &gt);
+        static int depth_limit_for(const Index n);
+        void intro_select(Index l, Index r, const Index k, int depth_limit);
+        void multi_select(Index l, Index r, const Index *first, 
+            const Index *last, int depth_limit);
+        bool choose_pivot(const Index l, const Index r);
+        Index two_way_partition(const Index l, const Index r);
+        Index block_partition(const Index l, const Index r);
+        Index vector_partition(const Index l, const Index r);
+        void parallel_sort(Index l, Index r, int depth_limit, TaskGroup &group);
+        Index parallel_partition(const Index l, const Index r);
+        void three_way_partition(const Index l, const Index r, 
+            Index &lt, Index &gt);
+        bool sort3(const Index a, const Index b, const Index c);
+        void insertion_sort(const Index l, const Index r);
+        void heap_sort(const Index l, const Index r);
+        void sift_down(const Index l, Index root, const Index n);
+        template <typename R>
+        std::vector<R> sort_records(std::vector<R> records) const;
+        void grow(std::vector<T> &buffer, std::size_t n);
+        bool use_radix(const Index n) const;
+        bool sort_presorted();
+        void radix_sort();
+        void merge_sort();
+        void total_order_sort();
+        TotalOrderLess<T, Compare> merge_order() const;
     
     public:
-        QuickSort();
-        int read_file(const std::string filename);
+        QuickSort(const Compare &comp = Compare());
+        int read_file(const std::string &filename);
+        int read_bytes(const char *first, const std::size_t size);
+        void set_array(const std::vector<T> &values);
+        void set_array(std::vector<T> &&values);
+        const std::vector<T> &get_array() const;
+        std::vector<T> release_array();
+        void swap_array(std::vector<T> &values);
+        void set_engine(const Engine engine);
+        void set_simd_level(const SimdLevel level);
+        void set_radix_bits(const unsigned bits);
+        void set_presort(const bool enabled);
+        void set_total_order(const bool enabled, const NanPolicy nan);
+        void set_arena(const bool enabled);
+        void set_seed(const std::uint64_t seed);
+        void set_thread_pool(ThreadPool *pool);
+        void set_write_mode(const WriteMode mode);
+        void set_output_format(const FileFormat format);
         int quick_sort();
-        int write_file(const std::string filename) const;
+        template <typename I>
+        std::vector<I> arg_sort();
+        template <typename P>
+        int sort_with_payload(std::vector<P> &payload, 
+            const PayloadSort method);
+        int select(const std::size_t k);
+        int multi_select(std::vector<std::size_t> ranks);
+        int partial_sort(const std::size_t k);
+        int write_file(const std::string &filename) const;
+        int format_output(std::vector<char> &out) const;
+        int external_sort_file(const std::string in_path, 
+            const std::string out_path, const std::size_t memory_budget);
+        int stream_sort(const int in_fd, const int out_fd, StreamStats &stats);
         double get_exe_time() const;
+        double get_cycles_per_element() const;
+        double get_parse_time() const;
+        std::size_t get_parse_bytes() const;
+        const PhaseCounters &get_sort_counters() const;
+        const PhaseCounters &get_read_counters() const;
+        const PhaseCounters &get_write_counters() const;
         void print_array() const;
 };
 
 // Entry Point - Driver Code to run QuickSort on input array
+// Tests include this file with QUICKSORT_NO_MAIN to use the QuickSort class
+#ifndef QUICKSORT_NO_MAIN
 int main(int argc, char **argv) {
     
-    // Ensure the right number of command line arguments were given
-    if (argc != 1){
-        std::cout << "Usage: ./quicksort" << std::endl;
+    // Parse command line options
+    Options opts;
+    if (!parse_args(argc, argv, opts)){
+        std::cout << "Usage: ./Azeem_Musa_QuickSort"
+            << " [--type=double|float|int64|uint32]"
+            << " [--engine=classic,hybrid,three_way,block,simd,parallel,"
+            << "radix,merge,auto]"
+            << " [--simd=auto|avx512|avx2|scalar] [--radix-bits=8|11]"
+            << " [--no-presort] [--total-order] [--nan=first|last|drop]"
+            << " [--threads=N] [--scaling]"
+            << " [--batch] [--readers=N] [--sorters=N] [--writers=N]"
+            << " [--queue-depth=N]"
+            << " [--write-mode=buffered|writev|direct]"
+            << " [--output-format=ascii|binary]"
+            << " [--external] [--memory-budget=MiB] [--stream]"
+            << " [--payload] [--select] [--arena] [--seed=N]"
+            << " [--warmup=N] [--reps=N] [--cache=DIR]"
+            << " [--async-io[=uring|threads]] [--io-depth=N]" << std::endl;
         return 1;
     }
 
+    if (opts.stream) {
+        // Sort stdin to stdout with the selected key type
+        int ret = 0;
+        switch (opts.key_type) {
+            case KeyType::float64:
+                ret = run_stream_sort<double>(opts);
+                break;
+            case KeyType::float32:
+                ret = run_stream_sort<float>(opts);
+                break;
+            case KeyType::int64:
+                ret = run_stream_sort<std::int64_t>(opts);
+                break;
+            case KeyType::uint32:
+                ret = run_stream_sort<std::uint32_t>(opts);
+                break;
+        }
+        return ret ? 0 : 1;
+    }
+
     std::map<std::string, int> dirs = get_dirs_from_user();
 
-    // Run quick sort on each of the 75 input files
-    if (!run_quick_sort_on_input_files(dirs)) {
+    // Run quick sort on each of the input files with the selected key type
+    int ret = 0;
+    switch (opts.key_type) {
+        case KeyType::float64:
+            ret = run_quick_sort_on_input_files<double>(dirs, opts);
+            break;
+        case KeyType::float32:
+            ret = run_quick_sort_on_input_files<float>(dirs, opts);
+            break;
+        case KeyType::int64:
+            ret = run_quick_sort_on_input_files<std::int64_t>(dirs, opts);
+            break;
+        case KeyType::uint32:
+            ret = run_quick_sort_on_input_files<std::uint32_t>(dirs, opts);
+            break;
+    }
+    if (!ret) {
         return 1;
     }
 
     return 0;
 }
+#endif  // QUICKSORT_NO_MAIN
+
+int parse_args(int argc, char **argv, Options &opts) {
+    /**
+     * Parses command line options of the form --name=value into opts
+     * 
+     * Parameters:
+     *      argc (int)          :   number of command line arguments
+     *      argv (char **)      :   command line arguments
+     *      opts (Options &)    :   options to populate
+     * 
+     * Returns:
+     *      int :   returns 1 if all options were valid, 0 if not
+     */
+
+    for (int i=1; i<argc; i++) {
+        std::string arg(argv[i]);
+        std::size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq+1);
+
+        if (name == "--type") {
+            if (value == "double") {
+                opts.key_type = KeyType::float64;
+            }
+            else if (value == "float") {
+                opts.key_type = KeyType::float32;
+            }
+            else if (value == "int64") {
+                opts.key_type = KeyType::int64;
+            }
+            else if (value == "uint32") {
+                opts.key_type = KeyType::uint32;
+            }
+            else {
+                std::cerr << "Unknown key type: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--engine") {
+            // Comma separated list of engines
+            opts.engines.clear();
+            std::istringstream iss(value);
+            std::string engine;
+            while (std::getline(iss, engine, ',')) {
+                if (!engine_names.count(engine)) {
+                    std::cerr << "Unknown engine: " << engine << std::endl;
+                    return 0;
+                }
+                opts.engines.push_back(engine_names.at(engine));
+            }
+            if (opts.engines.empty()) {
+                std::cerr << "No engine given" << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--simd") {
+            if (value == "auto") {
+                opts.simd_level = detect_simd_level();
+            }
+            else if (value == "avx512") {
+                opts.simd_level = SimdLevel::avx512;
+            }
+            else if (value == "avx2") {
+                opts.simd_level = SimdLevel::avx2;
+            }
+            else if (value == "scalar") {
+                opts.simd_level = SimdLevel::scalar;
+            }
+            else {
+                std::cerr << "Unknown instruction set: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--radix-bits") {
+            try {
+                int bits = std::stoi(value);
+                if (bits < 0 || !radix_digit_bits_valid(bits)) {
+                    throw std::invalid_argument(value);
+                }
+                opts.radix_bits = bits;
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Invalid radix digit width: " << value 
+                    << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--threads") {
+            try {
+                int threads = std::stoi(value);
+                if (threads < 1) {
+                    throw std::invalid_argument(value);
+                }
+                opts.threads = threads;
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Invalid thread count: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--scaling") {
+            opts.scaling = true;
+        }
+        else if (name == "--write-mode") {
+            if (value == "buffered") {
+                opts.write_mode = WriteMode::buffered;
+            }
+            else if (value == "writev") {
+                opts.write_mode = WriteMode::writev;
+            }
+            else if (value == "direct") {
+                opts.write_mode = WriteMode::direct;
+            }
+            else {
+                std::cerr << "Unknown write mode: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--output-format") {
+            if (value == "ascii") {
+                opts.output_format = FileFormat::ascii;
+            }
+            else if (value == "binary") {
+                opts.output_format = FileFormat::binary;
+            }
+            else {
+                std::cerr << "Unknown output format: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--batch") {
+            opts.batch = true;
+        }
+        else if (name == "--no-presort") {
+            opts.presort = false;
+        }
+        else if (name == "--total-order") {
+            opts.total_order = true;
+        }
+        else if (name == "--nan") {
+            if (value == "first") {
+                opts.nan_policy = NanPolicy::first;
+            }
+            else if (value == "last") {
+                opts.nan_policy = NanPolicy::last;
+            }
+            else if (value == "drop") {
+                opts.nan_policy = NanPolicy::drop;
+            }
+            else {
+                std::cerr << "Unknown NaN policy: " << value << std::endl;
+                return 0;
+            }
+            opts.total_order = true;
+        }
+        else if (name == "--seed") {
+            try {
+                std::size_t end = 0;
+                opts.seed = std::stoull(value, &end);
+                if (end != value.size() || value[0] == '-') {
+                    throw std::invalid_argument(value);
+                }
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Invalid seed: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--arena") {
+            opts.arena = true;
+        }
+        else if (name == "--warmup" || name == "--reps") {
+            int count = -1;
+            try {
+                std::size_t end = 0;
+                count = std::stoi(value, &end);
+                if (end != value.size()) {
+                    count = -1;
+                }
+            }
+            catch (const std::exception &e) {
+                count = -1;
+            }
+            if (count < (name == "--reps" ? 1 : 0)) {
+                std::cerr << "Invalid value for " << name << ": " << value 
+                    << std::endl;
+                return 0;
+            }
+            if (name == "--warmup") {
+                opts.warmup = count;
+            }
+            else {
+                opts.reps = count;
+            }
+        }
+        else if (name == "--select") {
+            opts.select = true;
+        }
+        else if (name == "--payload") {
+            opts.payload = true;
+        }
+        else if (name == "--stream") {
+            opts.stream = true;
+        }
+        else if (name == "--external") {
+            opts.external = true;
+        }
+        else if (name == "--cache") {
+            if (value.empty()) {
+                std::cerr << "Missing cache directory" << std::endl;
+                return 0;
+            }
+            opts.cache_dir = value;
+        }
+        else if (name == "--async-io") {
+            if (value.empty() || value == "uring") {
+                opts.io_backend = IoBackend::uring;
+            }
+            else if (value == "threads") {
+                opts.io_backend = IoBackend::threads;
+            }
+            else {
+                std::cerr << "Unknown I/O backend: " << value << std::endl;
+                return 0;
+            }
+            opts.async_io = true;
+        }
+        else if (name == "--io-depth") {
+            int depth = 0;
+            try {
+                depth = std::stoi(value);
+            }
+            catch (const std::exception &e) {
+                depth = 0;
+            }
+            if (depth < 1 || depth > 4096) {
+                std::cerr << "Invalid I/O depth: " << value << std::endl;
+                return 0;
+            }
+            opts.io_depth = depth;
+        }
+        else if (name == "--memory-budget") {
+            try {
+                long long mib = std::stoll(value);
+                if (mib < 1) {
+                    throw std::invalid_argument(value);
+                }
+                opts.memory_budget = static_cast<std::size_t>(mib) << 20;
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Invalid memory budget: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--readers" || name == "--sorters" 
+            || name == "--writers" || name == "--queue-depth") {
+            int count = 0;
+            try {
+                count = std::stoi(value);
+            }
+            catch (const std::exception &e) {
+                count = 0;
+            }
+            if (count < 1) {
+                std::cerr << "Invalid value for " << name << ": " << value 
+                    << std::endl;
+                return 0;
+            }
+            if (name == "--readers") {
+                opts.readers = count;
+            }
+            else if (name == "--sorters") {
+                opts.sorters = count;
+            }
+            else if (name == "--writers") {
+                opts.writers = count;
+            }
+            else {
+                opts.queue_depth = count;
+            }
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+std::string engine_name(const Engine engine) {
+    /**
+     * Returns:
+     *      string  :   name of the given engine as accepted by --engine
+     */
+    for (const auto &m : engine_names) {
+        if (m.second == engine) {
+            return m.first;
+        }
+    }
+    return "unknown";
+}
 
 std::map<std::string,int> get_dirs_from_user() {
     /**
@@ -172,9 +1160,16 @@ std::map<std::string,int> get_dirs_from_user() {
     return dirs;
 }
 
-int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs) {
+template <typename T>
+int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs,
+    const Options &opts) {
     /**
      * Runs the quick sort algorithm on each of the files in the given directory
+     * Values are parsed and sorted as type T
+     * Every file is sorted once with each of the selected engines
+     * Files are processed one at a time, or by the batch pipeline with --batch
+     * or the asynchronous I/O pipeline with --async-io
+     * With --external, every file is sorted once by the external sort
      * Outputs the sorted arrays and the execution times for each input size
      * 
      * Parameters:
@@ -182,13 +1177,45 @@ int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs) {
      *          the files they contain
      *          (.first = path to directory)
      *          (.second = input size)
+     *      opts (Options)          :   key type and engines to run
      * 
      * Returns:
      *      int :   returns 1 to indicate success or 0 for failure
      */
     
     // Initialize instance of QuickSort
-    QuickSort q;
+    QuickSort<T> q;
+    q.set_simd_level(opts.simd_level);
+    q.set_radix_bits(opts.radix_bits);
+    q.set_presort(opts.presort);
+    q.set_total_order(opts.total_order, opts.nan_policy);
+    q.set_arena(opts.arena);
+    q.set_seed(opts.seed);
+    q.set_write_mode(opts.write_mode);
+    q.set_output_format(opts.output_format);
+    std::cout << "Pivot seed: " << opts.seed << " (replay with --seed=" 
+        << opts.seed << ")" << std::endl;
+
+    // Sorted output cache and its lookups for each input size
+    std::unique_ptr<SortCache> cache;
+    std::map<int, CacheStats> cache_stats;
+    if (!opts.cache_dir.empty()) {
+        cache = std::make_unique<SortCache>(opts.cache_dir, cache_tag(opts));
+        if (!cache->open()) {
+            return 0;
+        }
+    }
+
+    // Thread pools for the parallel engine, one per timed thread count
+    // Scaling times powers of two only, so the idle pools hold about 2N 
+    //  threads instead of N^2/2
+    ThreadPools pools;
+    pools[opts.threads] = std::make_unique<ThreadPool>(opts.threads);
+    if (opts.scaling) {
+        for (unsigned t = 1; t < opts.threads; t *= 2) {
+            pools[t] = std::make_unique<ThreadPool>(t);
+        }
+    }
 
     // Create Root Output Directory
     std::time_t time;
@@ -202,9 +1229,39 @@ int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs) {
     std::string in_fn;
     std::string sorted_dir;
     std::string sorted_path;
+    std::string cache_key;
+
+    std::vector<T> input;           // unsorted values of the current file
+    std::vector<FileJob<T>> jobs;   // files for the batch or async pipeline
+    std::size_t files = 0;
+
+    // Asynchronous I/O creates every output directory up front, in one 
+    //  batch after the root
+    std::unique_ptr<AsyncFileIO> io;
+    if (opts.async_io && !opts.batch && !opts.external) {
+        io = std::make_unique<AsyncFileIO>(opts.io_backend, opts.io_depth);
+        if (io->backend() != opts.io_backend) {
+            std::cout << "io_uring is not available or lacks an operation "
+                << "used - using the thread pool" << std::endl;
+        }
+        std::vector<std::string> sorted_dirs;
+        for (auto m : dirs) {
+            std::string dir_name = m.first.substr(m.first.find_last_of("/"));
+            sorted_dirs.push_back(out_dir + "/" + dir_name + "-sorted");
+        }
+        if (!io->make_directories({out_dir}) 
+            || !io->make_directories(sorted_dirs)) {
+            std::cerr << "Error Creating Output Directories" << std::endl;
+            return 0;
+        }
+    }
+
+    // Allocations from here to the end of the last sort are reported
+    AllocationStats start_allocations = allocation_snapshot();
 
-    // map of input size to vector execution times of each file
-    std::map<int, std::vector<double>> exe_times;
+    // map of input size to execution times of each file for each engine
+    ExeTimes exe_times;
+    ParseTimes parse_times;
 
     // Repeat for each provided directory
     for (auto m : dirs) {
@@ -220,20 +1277,71 @@ int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs) {
 
         if(!exe_times.count(input_size)) {
             // If this input size is new, create new entry
-            exe_times.insert(std::pair<int, std::vector<double>>(
-                input_size, std::vector<double>()));
+            exe_times.insert(std::pair<int, std::map<std::string, 
+                std::vector<Timing>>>(input_size, 
+                std::map<std::string, std::vector<Timing>>()));
         }
 
         // Create Output Directory
         std::string dir_name = in_dir.substr(in_dir.find_last_of("/"));
         sorted_dir = fs::path(out_dir +"/"+ dir_name + "-sorted");
-        fs::create_directories(sorted_dir);
+        // Files left by an earlier run into the same directory may be hard
+        //  links of cache entries, so they are unlinked, not truncated
+        bool replace_outputs = fs::exists(sorted_dir);
+        if (!io) {
+            fs::create_directories(sorted_dir);
+        }
 
         // Read each input file in this dir and run quick sort on them
-        for (const auto & entry : fs::directory_iterator(in_dir)) {
-            in_path = std::string(entry.path());    // Path to each file
-            in_fn = in_path.substr(in_path.find_last_of("/") + 1);  // filename
-            sorted_path = fs::path(sorted_dir +"/"+ in_fn);
+        // readdir and in place assignment keep the path strings' capacity,
+        //  where a directory_iterator allocates several paths per file
+        std::unique_ptr<DIR, int (*)(DIR *)> dir(opendir(in_dir.c_str()), 
+            closedir);
+        if (!dir) {
+            std::cout << "Input Directory could not be read - Exiting" << std::endl;
+            return 0;
+        }
+        while (struct dirent *entry = readdir(dir.get())) {
+            if (std::strcmp(entry->d_name, ".") == 0 
+                || std::strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            in_fn.assign(entry->d_name);                        // filename
+            in_path.assign(in_dir).append("/").append(in_fn);   // Path to file
+            sorted_path.assign(sorted_dir).append("/").append(in_fn);
+            files++;
+            if (replace_outputs) {
+                unlink(sorted_path.c_str());
+            }
+
+            if (cache && cache->fetch(in_path, sorted_path, cache_key, 
+                cache_stats[input_size])) {
+                continue;       // Sorted output linked from the cache
+            }
+
+            if (opts.external) {
+                // Stream the file through runs with the first engine
+                q.set_engine(opts.engines.front());
+                q.set_thread_pool(pools.at(opts.threads).get());
+                if (!q.external_sort_file(in_path, sorted_path, 
+                    opts.memory_budget)) {
+                    return 0;
+                }
+                if (cache) {
+                    cache->store(cache_key, sorted_path);
+                }
+                exe_times[input_size]["external"].push_back(
+                    {q.get_exe_time(), q.get_cycles_per_element(), 
+                    q.get_sort_counters()});
+                continue;
+            }
+
+            if (opts.batch || io) {
+                // Leave reading, sorting and writing to the pipeline
+                jobs.push_back({in_path, sorted_path, input_size, {}, false,
+                    cache_key});
+                continue;
+            }
 
             // Read File
             if (!q.read_file(in_path)) {
@@ -241,314 +1349,3612 @@ int run_quick_sort_on_input_files(const std::map<std::string,int> &dirs) {
                 q.write_file(sorted_path);
                 return 0;
             }
+            parse_times[input_size].files++;
+            parse_times[input_size].bytes += q.get_parse_bytes();
+            parse_times[input_size].parse_time += q.get_parse_time();
+            record_read(q, exe_times[input_size]);
 
-            // Run Quick Sort
-            q.quick_sort();
-
-            // Get execution time
-            exe_times[input_size].push_back(q.get_exe_time());
+            // Run Quick Sort with each engine on a copy of the same input
+            input = q.get_array();
+            time_engines(q, input, opts, pools, exe_times[input_size]);
 
             // Write Sorted Array
-            q.write_file(sorted_path);
+            if (write_recorded(q, sorted_path, exe_times[input_size]) 
+                && cache) {
+                cache->store(cache_key, sorted_path);
+            }
         }
     }
 
+    if (opts.batch && !opts.external
+        && !run_batch_pipeline(jobs, opts, pools, exe_times, parse_times,
+            cache.get())) {
+        return 0;
+    }
+    AsyncTiming io_timing;
+    if (io && !run_async_pipeline(q, jobs, opts, pools, exe_times, 
+        parse_times, cache.get(), *io, io_timing)) {
+        return 0;
+    }
+    AllocationStats end_allocations = allocation_snapshot();
+
     // Write times and averages
+    if (opts.scaling && !save_scaling_table(out_dir, exe_times, opts.threads)) {
+        return 0;
+    }
+    if (!save_parse_throughput(out_dir, parse_times)) {
+        return 0;
+    }
+    if (cache && (!cache->save_index() 
+        || !save_cache_stats(out_dir, cache_stats))) {
+        return 0;
+    }
+    if (io && !save_io_stats(out_dir, io_timing)) {
+        return 0;
+    }
+    AllocationStats allocations;
+    allocations.count = end_allocations.count - start_allocations.count;
+    allocations.bytes = end_allocations.bytes - start_allocations.bytes;
+    allocations.huge_buffers = 
+        end_allocations.huge_buffers - start_allocations.huge_buffers;
+    allocations.huge_bytes = 
+        end_allocations.huge_bytes - start_allocations.huge_bytes;
+    if (!save_allocation_stats(out_dir, allocations, files, opts.arena)) {
+        return 0;
+    }
+    if (!save_benchmark_stats(out_dir, exe_times, opts)) {
+        return 0;
+    }
     return find_average_and_save_times(out_dir, exe_times);
 } 
 
-int find_average_and_save_times(const std::string out_dir, 
-    const std::map<int, std::vector<double>> &exe_times) {
+template <typename T, typename Q>
+void time_engines(Q &q, const std::vector<T> &input, const Options &opts,
+    ThreadPools &pools, std::map<std::string, std::vector<Timing>> &times) {
     /**
-     * Finds the average execution time of all the given files for each input size
-     * Writes the execution time and the averages to output directory
-     *
+     * Sorts a copy of the input with each selected engine and records the
+     *  timings. Every operation is run opts.warmup times untimed and
+     *  opts.reps times timed, each time on a fresh copy of the input.
+     *  The sorted array is left in q
+     * 
      * Parameters:
-     *      exe_times (map<int, vector<double>>): Execution times for each input size
-     *          (.first = input size)
-     *          (.second = array of execution times)
-     *
-     * Returns:
-     *      int :   returns 1 for success
+     *      q (QuickSort &)         :   sorter to run the engines on
+     *      input (vector<T>)       :   unsorted values
+     *      opts (Options)          :   engines to run
+     *      pools (ThreadPools)     :   thread pools for the parallel engine
+     *      times (map<string, vector<Timing>>) : timings of each engine for
+     *          the input size of this file
      */
 
-    std::ofstream time_out_file(fs::path(out_dir+"/Azeem_Musa_executionTime.txt"));
-    if (!time_out_file) {
-        std::cerr << "Error Opening Execution Time Output File" << std::endl;
-        return 0;   // return 0 to indicate failure
-    }
-    time_out_file << "Input Size    Execution Time (ms)" << std::endl;
-
-    std::map<int, double> averages;       // Average exe time for each input size
-    double sum = 0;
-    int input_size;
+    q.set_thread_pool(pools.at(opts.threads).get());
 
-    // Repeat for each input size
-    for (auto m : exe_times) {
-        sum = 0;
-        input_size = m.first;
-        // Write execution times and find average for each input size
-        for (auto exe_time : m.second) {
-            sum += exe_time;
-            time_out_file << input_size << "    " << exe_time << std::endl;
-        }
+    // Time the selection API with the first engine, to compare with the 
+    //  full sorts below
+    if (opts.select && !input.empty()) {
+        const std::size_t n = input.size();
+        q.set_engine(opts.engines.front());
+        time_repeated(q, opts, times["select-median"], [&]() {
+            q.set_array(input);
+            q.select(n / 2);
+        });
+        time_repeated(q, opts, times["select-percentiles"], [&]() {
+            q.set_array(input);
+            q.multi_select({n / 100, n / 20, n / 4, n / 2, 3 * n / 4, 
+                19 * n / 20, 99 * n / 100});
+        });
+        time_repeated(q, opts, times["top-100"], [&]() {
+            q.set_array(input);
+            q.partial_sort(std::min<std::size_t>(n, 100));
+        });
+    }
 
-        // Save average
-        if(!averages.count(input_size)) {
-            // Create new entry if new input size
-            averages.insert(std::pair<int, double>(
-                input_size, sum/m.second.size()));
-        }
-        else {
-            // Combine average with previous entry
-            double avg = sum/m.second.size();
-            averages[input_size] = (averages[input_size] + avg) / 2;
-        }
+    for (auto engine : opts.engines) {
+        q.set_engine(engine);
+        time_repeated(q, opts, times[engine_name(engine)], [&]() {
+            q.set_array(input);
+            q.quick_sort();
+        });
     }
-    time_out_file.close();
 
-    // Write Averages to file
-    std::ofstream avg_out_file(fs::path(out_dir+"/Azeem_Musa_averageExecutionTime.txt"));
-    if (!avg_out_file) {
-        std::cerr << "Error Opening Average Output File" << std::endl;
-        return 0;   // return 0 to indicate failure
+    // Time argsort and key/payload sorts with the first engine. The 
+    //  payload is the row number of each value, as in a table of records
+    if (opts.payload) {
+        q.set_engine(opts.engines.front());
+        q.set_array(input);
+        time_repeated(q, opts, times["argsort-u32"], [&]() {
+            q.template arg_sort<std::uint32_t>();
+        });
+        time_repeated(q, opts, times["argsort-u64"], [&]() {
+            q.template arg_sort<std::uint64_t>();
+        });
+
+        std::vector<std::uint64_t> payload(input.size());
+        time_repeated(q, opts, times["payload-indices"], [&]() {
+            q.set_array(input);
+            std::iota(payload.begin(), payload.end(), 0);
+            q.sort_with_payload(payload, PayloadSort::indices);
+        });
+        time_repeated(q, opts, times["payload-packed"], [&]() {
+            q.set_array(input);
+            std::iota(payload.begin(), payload.end(), 0);
+            q.sort_with_payload(payload, PayloadSort::packed);
+        });
     }
 
-    avg_out_file << "Input Size    Average Execution Time (ms)" << std::endl;
-    for (auto m : averages) {
-        avg_out_file << m.first << "    " << m.second << std::endl;
+    // Time the parallel engine with each thread count
+    if (opts.scaling) {
+        q.set_engine(Engine::parallel);
+        for (auto &p : pools) {
+            q.set_thread_pool(p.second.get());
+            time_repeated(q, opts, 
+                times["parallel-" + std::to_string(p.first)], [&]() {
+                q.set_array(input);
+                q.quick_sort();
+            });
+        }
     }
-    avg_out_file.close();
-    return 1;
 }
 
-
-
-
-// QuickSort Functions
-
-QuickSort::QuickSort() {
+template <typename Q, typename Run>
+void time_repeated(Q &q, const Options &opts, std::vector<Timing> &times,
+    Run run) {
     /**
-     * Default Constructor
+     * Runs a timed operation opts.warmup times without recording it, then
+     *  opts.reps times recording the timing of q after each run
      * 
-     * Initialize A as empty vector
-     * Provides seed for random number generation later
+     * Parameters:
+     *      q (QuickSort &)         :   sorter whose last timing is recorded
+     *      opts (Options)          :   warmup and repetition counts
+     *      times (vector<Timing>)  :   timings are added here
+     *      run (Run)               :   sets up and runs the operation
      */
-    A = std::vector<double>();
-    std::srand(time(0));            // Used for random pivot generation
+
+    for (unsigned i = 0; i < opts.warmup + opts.reps; i++) {
+        run();
+        if (i >= opts.warmup) {
+            times.push_back({q.get_exe_time(), q.get_cycles_per_element(),
+                q.get_sort_counters()});
+        }
+    }
 }
 
-int QuickSort::read_file(const std::string filename){
+template <typename Q>
+void record_read(const Q &q, std::map<std::string, std::vector<Timing>> &times) {
+    /**
+     * Records the parse time and counters of the last file q read as a 
+     *  "read" timing, in builds with QUICKSORT_INSTRUMENT only
+     * 
+     * Parameters:
+     *      q (QuickSort)           :   sorter that read the file
+     *      times (map<string, vector<Timing>>) : timings of the input size
+     *          of the file
+     */
+    if constexpr (instrument_enabled) {
+        times["read"].push_back({q.get_parse_time(), 0, 
+            q.get_read_counters()});
+    }
+}
+
+template <typename Q>
+int write_recorded(const Q &q, const std::string &path,
+    std::map<std::string, std::vector<Timing>> &times) {
+    /**
+     * Writes the array of q to a file. Builds with QUICKSORT_INSTRUMENT 
+     *  also record the time and counters of the write as a "write" timing
+     * 
+     * Parameters:
+     *      q (QuickSort)           :   sorter holding the sorted array
+     *      path (string)           :   file to write
+     *      times (map<string, vector<Timing>>) : timings of the input size
+     *          of the file
+     * 
+     * Returns:
+     *      int :   Returns 1 if the file was written, 0 if not
+     */
+    auto write_start = std::chrono::steady_clock::now();
+    int ret = q.write_file(path);
+    if constexpr (instrument_enabled) {
+        times["write"].push_back({std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - write_start).count(), 0,
+            q.get_write_counters()});
+    }
+    return ret;
+}
+
+template <typename T>
+int run_batch_pipeline(std::vector<FileJob<T>> &jobs, const Options &opts,
+    ThreadPools &pools, ExeTimes &exe_times, ParseTimes &parse_times,
+    SortCache *cache) {
+    /**
+     * Reads, sorts and writes the given files in a three stage pipeline
+     *  - Reader threads claim the next file with an atomic counter and parse it.
+     *    Parse timings go to a per-reader ParseTimes
+     *  - Sorter threads each own a QuickSort and time every selected engine.
+     *    Timings go to a per-sorter ExeTimes that is merged after the
+     *    threads are joined, so recording them takes no lock
+     *  - Writer threads write the sorted arrays and add them to the cache
+     * Stages are connected by bounded queues, so at most queue-depth files
+     *  wait between two stages
+     * 
+     * Parameters:
+     *      jobs (vector<FileJob>)  :   files to process
+     *      opts (Options)          :   engines and pipeline sizes
+     *      pools (ThreadPools)     :   thread pools for the parallel engine
+     *      exe_times (ExeTimes)    :   timings are added here
+     *      parse_times (ParseTimes):   parse timings are added here
+     *      cache (SortCache *)     :   sorted output cache, or nullptr
+     * 
+     * Returns:
+     *      int :   returns 1 if every file was read, 0 if not
+     */
+
+    // Engines that sort on the shared thread pool already use every thread,
+    //  so by default they get a single sorter instead of threads^2 threads
+    bool pooled = opts.scaling;
+    for (auto engine : opts.engines) {
+        pooled |= (engine == Engine::parallel || engine == Engine::merge);
+    }
+    const unsigned sorters = (opts.sorters > 0) ? opts.sorters 
+        : (pooled ? 1 : opts.threads);
+    const unsigned depth = (opts.queue_depth > 0) ? opts.queue_depth : 2*sorters;
+
+    BoundedQueue<FileJob<T>> read_queue(depth);     // readers -> sorters
+    BoundedQueue<FileJob<T>> write_queue(depth);    // sorters -> writers
+    std::atomic<std::size_t> next_job(0);
+    std::atomic<unsigned> readers_left(opts.readers);
+    std::atomic<unsigned> sorters_left(sorters);
+    std::atomic<bool> failed(false);
+    std::vector<ExeTimes> sorter_times(sorters);
+    std::vector<ParseTimes> reader_times(opts.readers);
+    // Read and write counters of each reader and writer (instrumented 
+    //  builds only)
+    std::vector<ExeTimes> io_times(opts.readers + opts.writers);
+    // Arrays of written files, reused by readers in arena mode. At most one
+    //  array per queue slot and per thread is in flight
+    BufferPool<T> free_buffers(2 * depth + opts.readers + sorters 
+        + opts.writers);
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < opts.readers; i++) {
+        threads.emplace_back([&, i]() {
+            QuickSort<T> reader;
+            reader.set_arena(opts.arena);
+            std::size_t k;
+            while (!failed && (k = next_job++) < jobs.size()) {
+                FileJob<T> job = std::move(jobs[k]);
+                if (opts.arena) {
+                    reader.set_array(free_buffers.acquire());
+                }
+                job.read_ok = reader.read_file(job.in_path);
+                job.values = reader.release_array();
+                if (!job.read_ok) {
+                    // Stop reading new files, the empty array is still written
+                    failed = true;
+                }
+                else {
+                    ParseTiming &timing = reader_times[i][job.input_size];
+                    timing.files++;
+                    timing.bytes += reader.get_parse_bytes();
+                    timing.parse_time += reader.get_parse_time();
+                    record_read(reader, io_times[i][job.input_size]);
+                }
+                read_queue.push(std::move(job));
+            }
+            if (--readers_left == 0) {
+                read_queue.close();
+            }
+        });
+    }
+    for (unsigned i = 0; i < sorters; i++) {
+        threads.emplace_back([&, i]() {
+            QuickSort<T> q;
+            q.set_simd_level(opts.simd_level);
+            q.set_radix_bits(opts.radix_bits);
+            q.set_presort(opts.presort);
+            q.set_total_order(opts.total_order, opts.nan_policy);
+            q.set_arena(opts.arena);
+            q.set_seed(opts.seed);
+            FileJob<T> job;
+            while (read_queue.pop(job)) {
+                if (job.read_ok) {
+                    time_engines(q, job.values, opts, pools, 
+                        sorter_times[i][job.input_size]);
+                    // The sorter keeps the unsorted array as its next buffer
+                    q.swap_array(job.values);
+                }
+                write_queue.push(std::move(job));
+            }
+            if (--sorters_left == 0) {
+                write_queue.close();
+            }
+        });
+    }
+    for (unsigned i = 0; i < opts.writers; i++) {
+        threads.emplace_back([&, i]() {
+            QuickSort<T> writer;
+            writer.set_write_mode(opts.write_mode);
+            writer.set_output_format(opts.output_format);
+            FileJob<T> job;
+            while (write_queue.pop(job)) {
+                writer.set_array(std::move(job.values));
+                if (write_recorded(writer, job.sorted_path, 
+                    io_times[opts.readers + i][job.input_size]) 
+                    && job.read_ok && cache != nullptr) {
+                    cache->store(job.cache_key, job.sorted_path);
+                }
+                if (opts.arena) {
+                    free_buffers.release(writer.release_array());
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Merge the timings of each sorter, reader and writer
+    sorter_times.insert(sorter_times.end(), io_times.begin(), io_times.end());
+    for (auto &times : sorter_times) {
+        for (auto &m : times) {
+            for (auto &e : m.second) {
+                auto &all = exe_times[m.first][e.first];
+                all.insert(all.end(), e.second.begin(), e.second.end());
+            }
+        }
+    }
+    for (auto &times : reader_times) {
+        for (auto &m : times) {
+            parse_times[m.first].files += m.second.files;
+            parse_times[m.first].bytes += m.second.bytes;
+            parse_times[m.first].parse_time += m.second.parse_time;
+        }
+    }
+
+    return failed ? 0 : 1;
+}
+
+template <typename T, typename Q>
+int run_async_pipeline(Q &q, std::vector<FileJob<T>> &jobs, 
+    const Options &opts, ThreadPools &pools, ExeTimes &exe_times, 
+    ParseTimes &parse_times, SortCache *cache, AsyncFileIO &io,
+    AsyncTiming &timing) {
+    /**
+     * Reads, sorts and writes the given files with asynchronous I/O
+     *  - Up to io-depth files are being read or written at once. Every 
+     *    finished read starts the next one before the file is parsed
+     *  - The engines are timed on the calling thread like in the sequential
+     *    loop, while the queued reads and writes run
+     *  - The sorted array is formatted into the buffer the file was read
+     *    into, which is then written. Written files are added to the cache
+     * A file that cannot be read stops further reads, and its empty array is
+     *  still written
+     * 
+     * Parameters:
+     *      q (QuickSort &)         :   sorter to run the engines on
+     *      jobs (vector<FileJob>)  :   files to process
+     *      opts (Options)          :   engines to run
+     *      pools (ThreadPools)     :   thread pools for the parallel engine
+     *      exe_times (ExeTimes)    :   timings are added here
+     *      parse_times (ParseTimes):   parse timings are added here
+     *      cache (SortCache *)     :   sorted output cache, or nullptr
+     *      io (AsyncFileIO &)      :   reads and writes the files
+     *      timing (AsyncTiming &)  :   set to the I/O and sort time of the run
+     * 
+     * Returns:
+     *      int :   returns 1 if every file was read and written, 0 if not
+     */
+
+    auto run_start = std::chrono::steady_clock::now();
+    std::size_t next_read = 0;
+    bool failed = false;
+    std::vector<T> input;           // unsorted values of the current file
+
+    auto submit_read = [&]() {
+        IoRequest request;
+        request.id = next_read;
+        request.path = jobs[next_read].in_path;
+        io.submit(std::move(request));
+        next_read++;
+    };
+    while (next_read < jobs.size() && next_read < opts.io_depth) {
+        submit_read();
+    }
+
+    IoRequest request;
+    while (io.next(request)) {
+        FileJob<T> &job = jobs[request.id];
+        auto &times = exe_times[job.input_size];
+        if (request.write) {
+            if (request.error != 0) {
+                std::cerr << "Error Writing Output File" << std::endl;
+                failed = true;
+            }
+            else if (job.read_ok && cache != nullptr) {
+                cache->store(job.cache_key, job.sorted_path);
+            }
+            continue;
+        }
+
+        // Keep the reads in flight while this file is sorted
+        if (!failed && next_read < jobs.size()) {
+            submit_read();
+        }
+
+        if (request.error != 0) {
+            std::cerr << "Error Opening Input File" << std::endl;
+            job.read_ok = false;
+        }
+        else {
+            job.read_ok = q.read_bytes(request.data.data(), 
+                request.data.size());
+        }
+        if (job.read_ok) {
+            parse_times[job.input_size].files++;
+            parse_times[job.input_size].bytes += q.get_parse_bytes();
+            parse_times[job.input_size].parse_time += q.get_parse_time();
+            record_read(q, times);
+
+            // Run Quick Sort with each engine on a copy of the same input
+            input = q.get_array();
+            auto sort_start = std::chrono::steady_clock::now();
+            time_engines(q, input, opts, pools, times);
+            timing.sort_time += std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - sort_start).count();
+        }
+        else {
+            // Stop reading new files, the empty array is still written
+            failed = true;
+            q.set_array(std::vector<T>());
+        }
+
+        // Format the sorted array and queue its write
+        auto format_start = std::chrono::steady_clock::now();
+        if (!q.format_output(request.data)) {
+            failed = true;
+            continue;
+        }
+        if constexpr (instrument_enabled) {
+            times["write"].push_back({std::chrono::duration<double, 
+                std::milli>(std::chrono::steady_clock::now() 
+                - format_start).count(), 0, q.get_write_counters()});
+        }
+        request.write = true;
+        request.error = 0;
+        request.path = job.sorted_path;
+        io.submit(std::move(request));
+        request = IoRequest();
+    }
+
+    timing.backend = io.backend();
+    timing.files = jobs.size();
+    timing.io = io.stats();
+    timing.wall_time = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - run_start).count();
+    return failed ? 0 : 1;
+}
+
+int find_average_and_save_times(const std::string out_dir, 
+    const ExeTimes &exe_times) {
+    /**
+     * Finds the average execution time of all the given files for each input
+     *  size and engine
+     * Writes the execution time and the averages to output directory
+     *
+     * Parameters:
+     *      exe_times (ExeTimes):   Execution times for each input size
+     *          (.first = input size)
+     *          (.second = map of engine name to array of timings)
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream time_out_file(fs::path(out_dir+"/Azeem_Musa_executionTime.txt"));
+    if (!time_out_file) {
+        std::cerr << "Error Opening Execution Time Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    time_out_file << "Input Size    Engine    Execution Time (ms)"
+        << "    Cycles/Element";
+    write_counter_header(time_out_file);
+    time_out_file << std::endl;
+
+    // Average exe time for each input size and engine
+    std::map<std::pair<int, std::string>, Timing> averages;
+    int input_size;
+
+    // Repeat for each input size and engine
+    for (auto m : exe_times) {
+        input_size = m.first;
+        for (auto e : m.second) {
+            // Write execution times and find the mean over every file of 
+            //  this input size, whichever directory it is in
+            double sum = 0;
+            double cycles_sum = 0;
+            for (auto timing : e.second) {
+                sum += timing.exe_time;
+                cycles_sum += timing.cycles_per_element;
+                time_out_file << input_size << "    " << e.first << "    " 
+                    << timing.exe_time << "    " << timing.cycles_per_element;
+                write_counters(time_out_file, timing.counters);
+                time_out_file << std::endl;
+            }
+            if (e.second.empty()) {
+                continue;
+            }
+
+            // Save average
+            averages[{input_size, e.first}] = 
+                {sum/e.second.size(), cycles_sum/e.second.size(),
+                average_counters(e.second)};
+        }
+    }
+    time_out_file.close();
+
+    // Write Averages to file
+    std::ofstream avg_out_file(fs::path(out_dir+"/Azeem_Musa_averageExecutionTime.txt"));
+    if (!avg_out_file) {
+        std::cerr << "Error Opening Average Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+
+    avg_out_file << "Input Size    Engine    Average Execution Time (ms)" 
+        << "    Cycles/Element";
+    write_counter_header(avg_out_file);
+    avg_out_file << std::endl;
+    for (auto m : averages) {
+        avg_out_file << m.first.first << "    " << m.first.second << "    " 
+            << m.second.exe_time << "    " << m.second.cycles_per_element;
+        write_counters(avg_out_file, m.second.counters);
+        avg_out_file << std::endl;
+    }
+    avg_out_file.close();
+    return 1;
+}
+
+void write_counter_header(std::ostream &out) {
+    /**
+     * Writes the names of the counter columns of the execution time files,
+     *  in builds with QUICKSORT_INSTRUMENT only
+     *
+     * Parameters:
+     *      out (ostream &) :   execution time file
+     */
+    if constexpr (instrument_enabled) {
+        for (const char *name : perf_event_names) {
+            out << "    " << name;
+        }
+        out << "    Comparisons    Swaps    Partitions    Max Depth"
+            << "    Imbalance";
+    }
+}
+
+void write_counters(std::ostream &out, const PhaseCounters &counters) {
+    /**
+     * Writes the counter columns of one timing, in builds with 
+     *  QUICKSORT_INSTRUMENT only. Hardware events that could not be counted
+     *  are written as n/a
+     *
+     * Parameters:
+     *      out (ostream &)             :   execution time file
+     *      counters (PhaseCounters)    :   counters of the timing
+     */
+    if constexpr (instrument_enabled) {
+        for (int e = 0; e < perf_event_count; e++) {
+            out << "    ";
+            if (counters.available[e]) {
+                out << static_cast<std::uint64_t>(counters.events[e]);
+            }
+            else {
+                out << "n/a";
+            }
+        }
+        out << "    " << counters.comparisons << "    " << counters.swaps 
+            << "    " << counters.partitions << "    " << counters.max_depth 
+            << "    " << counters.imbalance;
+    }
+}
+
+PhaseCounters average_counters(const std::vector<Timing> &timings) {
+    /**
+     * Parameters:
+     *      timings (vector<Timing>)    :   timings of one input size and 
+     *                                      engine
+     *
+     * Returns:
+     *      PhaseCounters   :   mean of every counter. A hardware event is
+     *                          available if it was counted in every timing
+     */
+    PhaseCounters avg;
+    if (timings.empty()) {
+        return avg;
+    }
+    avg.available.fill(true);
+    double comparisons = 0;
+    double swaps = 0;
+    double partitions = 0;
+    double max_depth = 0;
+    for (const auto &timing : timings) {
+        const PhaseCounters &c = timing.counters;
+        for (int e = 0; e < perf_event_count; e++) {
+            avg.events[e] += c.events[e];
+            avg.available[e] = avg.available[e] && c.available[e];
+        }
+        comparisons += c.comparisons;
+        swaps += c.swaps;
+        partitions += c.partitions;
+        max_depth += c.max_depth;
+        avg.imbalance += c.imbalance;
+    }
+    const double n = static_cast<double>(timings.size());
+    for (int e = 0; e < perf_event_count; e++) {
+        avg.events[e] /= n;
+    }
+    avg.comparisons = std::llround(comparisons / n);
+    avg.swaps = std::llround(swaps / n);
+    avg.partitions = std::llround(partitions / n);
+    avg.max_depth = std::llround(max_depth / n);
+    avg.imbalance /= n;
+    return avg;
+}
+
+BenchmarkStats summarize_timings(const std::vector<Timing> &timings) {
+    /**
+     * Finds the statistics of the timings of one input size and engine
+     * The confidence interval is mean +- t * stddev / sqrt(samples), with
+     *  the two-sided 95% quantile of Student's t distribution
+     *
+     * Parameters:
+     *      timings (vector<Timing>)    :   samples of one input size and 
+     *                                      engine
+     *
+     * Returns:
+     *      BenchmarkStats  :   statistics of the samples, all 0 if there are
+     *                          none
+     */
+
+    // Two-sided 95% quantiles of Student's t for 1 to 30 degrees of freedom
+    static const double t_quantiles[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 
+        2.048, 2.045, 2.042
+    };
+    const double z_quantile = 1.960;    // more than 30 degrees of freedom
+
+    BenchmarkStats stats;
+    stats.samples = timings.size();
+    if (timings.empty()) {
+        return stats;
+    }
+
+    std::vector<double> times;
+    std::vector<double> cycles;
+    for (const auto &timing : timings) {
+        times.push_back(timing.exe_time);
+        cycles.push_back(timing.cycles_per_element);
+    }
+    std::sort(times.begin(), times.end());
+    std::sort(cycles.begin(), cycles.end());
+
+    const double n = static_cast<double>(times.size());
+    stats.mean = std::accumulate(times.begin(), times.end(), 0.0) / n;
+    stats.median = percentile(times, 0.5);
+    stats.p95 = percentile(times, 0.95);
+    stats.median_cycles = percentile(cycles, 0.5);
+    if (times.size() > 1) {
+        double squares = 0;
+        for (double t : times) {
+            squares += (t - stats.mean) * (t - stats.mean);
+        }
+        stats.stddev = std::sqrt(squares / (n - 1));
+    }
+    const std::size_t dof = times.size() - 1;
+    const double quantile = (dof == 0) ? 0 : (dof <= 30) 
+        ? t_quantiles[dof - 1] : z_quantile;
+    stats.ci_low = stats.mean - quantile * stats.stddev / std::sqrt(n);
+    stats.ci_high = stats.mean + quantile * stats.stddev / std::sqrt(n);
+    return stats;
+}
+
+double percentile(const std::vector<double> &sorted, const double p) {
+    /**
+     * Parameters:
+     *      sorted (vector<double>) :   samples in ascending order, not empty
+     *      p (double)              :   fraction of samples below the result,
+     *                                  0 to 1
+     *
+     * Returns:
+     *      double  :   the p-th quantile, interpolated linearly between the
+     *                  two closest samples
+     */
+    double pos = p * (sorted.size() - 1);
+    std::size_t lower = static_cast<std::size_t>(pos);
+    if (lower + 1 >= sorted.size()) {
+        return sorted.back();
+    }
+    return sorted[lower] + (pos - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+int save_benchmark_stats(const std::string out_dir, const ExeTimes &exe_times,
+    const Options &opts) {
+    /**
+     * Writes the statistics of every input size and engine to 
+     *  Azeem_Musa_benchmark.csv and Azeem_Musa_benchmark.json
+     *
+     * Parameters:
+     *      out_dir (string)        :   output directory
+     *      exe_times (ExeTimes)    :   samples of each input size and engine
+     *      opts (Options)          :   warmup, repetitions and seed of the run
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream csv_file(fs::path(out_dir+"/Azeem_Musa_benchmark.csv"));
+    std::ofstream json_file(fs::path(out_dir+"/Azeem_Musa_benchmark.json"));
+    if (!csv_file || !json_file) {
+        std::cerr << "Error Opening Benchmark Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    csv_file.precision(9);
+    json_file.precision(9);
+
+    csv_file << "input_size,engine,samples,mean_ms,median_ms,p95_ms,stddev_ms,"
+        << "ci95_low_ms,ci95_high_ms,median_cycles_per_element" << std::endl;
+    json_file << "{" << std::endl
+        << "  \"warmup\": " << opts.warmup << "," << std::endl
+        << "  \"reps\": " << opts.reps << "," << std::endl
+        << "  \"seed\": " << opts.seed << "," << std::endl
+        << "  \"results\": [";
+
+    bool first = true;
+    for (const auto &m : exe_times) {
+        for (const auto &e : m.second) {
+            if (e.second.empty()) {
+                continue;
+            }
+            BenchmarkStats stats = summarize_timings(e.second);
+            csv_file << m.first << "," << e.first << "," << stats.samples 
+                << "," << stats.mean << "," << stats.median << "," 
+                << stats.p95 << "," << stats.stddev << "," << stats.ci_low 
+                << "," << stats.ci_high << "," << stats.median_cycles 
+                << std::endl;
+
+            json_file << (first ? "" : ",") << std::endl
+                << "    {\"input_size\": " << m.first 
+                << ", \"engine\": \"" << e.first << "\""
+                << ", \"samples\": " << stats.samples
+                << ", \"mean_ms\": " << stats.mean
+                << ", \"median_ms\": " << stats.median
+                << ", \"p95_ms\": " << stats.p95
+                << ", \"stddev_ms\": " << stats.stddev
+                << ", \"ci95_low_ms\": " << stats.ci_low
+                << ", \"ci95_high_ms\": " << stats.ci_high
+                << ", \"median_cycles_per_element\": " << stats.median_cycles
+                << "}";
+            first = false;
+        }
+    }
+    json_file << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+    csv_file.close();
+    json_file.close();
+    if (csv_file.fail() || json_file.fail()) {
+        std::cerr << "Error Writing Benchmark Output File" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+
+int save_scaling_table(const std::string out_dir, const ExeTimes &exe_times,
+    const unsigned max_threads) {
+    /**
+     * Writes the average execution time of the parallel engine with each
+     *  timed thread count up to max_threads and the speedup over one thread
+     *  for each input size
+     *
+     * Parameters:
+     *      out_dir (string)        :   output directory
+     *      exe_times (ExeTimes)    :   timings with "parallel-N" engine entries
+     *      max_threads (unsigned)  :   largest thread count that was timed
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream out_file(fs::path(out_dir+"/Azeem_Musa_scaling.txt"));
+    if (!out_file) {
+        std::cerr << "Error Opening Scaling Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    out_file << "Input Size    Threads    Average Execution Time (ms)    Speedup"
+        << std::endl;
+
+    for (auto m : exe_times) {
+        double base = 0;    // Average time with one thread
+        for (unsigned t = 1; t <= max_threads; t++) {
+            auto e = m.second.find("parallel-" + std::to_string(t));
+            if (e == m.second.end() || e->second.empty()) {
+                continue;
+            }
+            double sum = 0;
+            for (auto timing : e->second) {
+                sum += timing.exe_time;
+            }
+            double avg = sum / e->second.size();
+            if (t == 1) {
+                base = avg;
+            }
+            out_file << m.first << "    " << t << "    " << avg << "    " 
+                << ((avg > 0) ? base / avg : 0) << std::endl;
+        }
+    }
+    out_file.close();
+    return 1;
+}
+
+template <typename T>
+int run_stream_sort(const Options &opts) {
+    /**
+     * Sorts the values read from stdin and writes them to stdout, for use as
+     *  a stage of a Unix pipeline
+     * The first selected engine sorts the runs of the streaming sort
+     * Reports the size of the sort, the time to first output and the peak
+     *  memory on stderr, so stdout only holds the sorted values
+     * 
+     * Parameters:
+     *      opts (Options)  :   key type, engine and thread count
+     * 
+     * Returns:
+     *      int :   returns 1 to indicate success or 0 for failure
+     */
+
+    if (opts.output_format == FileFormat::binary) {
+        std::cerr << "Streaming output is ASCII only" << std::endl;
+        return 0;
+    }
+
+    QuickSort<T> q;
+    q.set_simd_level(opts.simd_level);
+    q.set_radix_bits(opts.radix_bits);
+    q.set_presort(opts.presort);
+    q.set_total_order(opts.total_order, opts.nan_policy);
+    q.set_arena(opts.arena);
+    q.set_seed(opts.seed);
+    q.set_engine(opts.engines.front());
+    std::unique_ptr<ThreadPool> pool;
+    if (opts.engines.front() == Engine::parallel 
+        || opts.engines.front() == Engine::merge) {
+        pool = std::make_unique<ThreadPool>(opts.threads);
+        q.set_thread_pool(pool.get());
+    }
+
+    StreamStats stats;
+    if (!q.stream_sort(STDIN_FILENO, STDOUT_FILENO, stats)) {
+        return 0;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cerr << "Sorted " << stats.values << " values in " << stats.runs 
+        << " runs" << std::endl;
+    std::cerr << "Time to first output: " << stats.first_output << " ms ("
+        << stats.after_input << " ms after end of input)" << std::endl;
+    std::cerr << "Total time: " << stats.total << " ms" << std::endl;
+    std::cerr << "Peak memory: " << usage.ru_maxrss / 1024.0 << " MiB" 
+        << std::endl;
+    return 1;
+}
+
+int save_parse_throughput(const std::string out_dir, 
+    const ParseTimes &parse_times) {
+    /**
+     * Writes the parse time and throughput of the input files of each 
+     *  input size
+     *
+     * Parameters:
+     *      out_dir (string)        :   output directory
+     *      parse_times (ParseTimes):   parse timings for each input size
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream out_file(fs::path(out_dir+"/Azeem_Musa_parseThroughput.txt"));
+    if (!out_file) {
+        std::cerr << "Error Opening Parse Throughput Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    out_file << "Input Size    Files    Size (MB)    Parse Time (ms)"
+        << "    Throughput (MB/s)" << std::endl;
+
+    for (auto m : parse_times) {
+        double megabytes = m.second.bytes / 1e6;
+        double seconds = m.second.parse_time / 1e3;
+        out_file << m.first << "    " << m.second.files << "    " << megabytes 
+            << "    " << m.second.parse_time << "    " 
+            << ((seconds > 0) ? megabytes / seconds : 0) << std::endl;
+    }
+    out_file.close();
+    return 1;
+}
+
+std::string cache_tag(const Options &opts) {
+    /**
+     * Parameters:
+     *      opts (Options)  :   settings of the run
+     * 
+     * Returns:
+     *      string  :   the settings that change the sorted output, which 
+     *                  are part of every cache key
+     */
+    std::string tag;
+    switch (opts.key_type) {
+        case KeyType::float64:
+            tag = "double";
+            break;
+        case KeyType::float32:
+            tag = "float";
+            break;
+        case KeyType::int64:
+            tag = "int64";
+            break;
+        case KeyType::uint32:
+            tag = "uint32";
+            break;
+    }
+    tag += (opts.output_format == FileFormat::binary) ? "-binary" : "-ascii";
+    bool floating = opts.key_type == KeyType::float64 
+        || opts.key_type == KeyType::float32;
+    if (opts.total_order && floating) {
+        const char *nan_names[] = {"first", "last", "drop"};
+        tag += std::string("-nan-") 
+            + nan_names[static_cast<int>(opts.nan_policy)];
+    }
+    return tag;
+}
+
+int save_cache_stats(const std::string out_dir, 
+    const std::map<int, CacheStats> &cache_stats) {
+    /**
+     * Writes the cache lookups of each input size and prints the hit rate
+     *  of the run
+     *
+     * Parameters:
+     *      out_dir (string)                    :   output directory
+     *      cache_stats (map<int, CacheStats>)  :   lookups of each input size
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream out_file(fs::path(out_dir+"/Azeem_Musa_cache.txt"));
+    if (!out_file) {
+        std::cerr << "Error Opening Cache Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    out_file << "Input Size    Files    Hits    Misses    Hit Rate (%)"
+        << "    Unchanged    Hashed (MB)    Hash Time (ms)" << std::endl;
+
+    CacheStats total;
+    for (auto m : cache_stats) {
+        const CacheStats &c = m.second;
+        out_file << m.first << "    " << c.files << "    " << c.hits << "    "
+            << c.files - c.hits << "    " 
+            << ((c.files > 0) ? 100.0 * c.hits / c.files : 0) << "    " 
+            << c.unchanged << "    " << c.hashed_bytes / 1e6 << "    " 
+            << c.hash_time << std::endl;
+        total.files += c.files;
+        total.hits += c.hits;
+        total.unchanged += c.unchanged;
+    }
+    out_file.close();
+
+    std::cout << "Cache: " << total.hits << " of " << total.files 
+        << " files hit (" 
+        << ((total.files > 0) ? 100.0 * total.hits / total.files : 0) 
+        << "%), " << total.unchanged << " recognized without hashing" 
+        << std::endl;
+    return 1;
+}
+
+int save_io_stats(const std::string out_dir, const AsyncTiming &timing) {
+    /**
+     * Writes the I/O of an asynchronous run and prints its system calls and
+     *  I/O wait next to its sort time
+     *
+     * Parameters:
+     *      out_dir (string)        :   output directory
+     *      timing (AsyncTiming)    :   I/O and sort time of the run
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream out_file(fs::path(out_dir+"/Azeem_Musa_io.txt"));
+    if (!out_file) {
+        std::cerr << "Error Opening I/O Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    const char *backend = (timing.backend == IoBackend::uring) 
+        ? "io_uring" : "threads";
+    const double per_file = (timing.files > 0) 
+        ? static_cast<double>(timing.io.syscalls) / timing.files : 0;
+    out_file << "Backend    Files    Operations    Syscalls    Syscalls/File"
+        << "    I/O Wait (ms)    Sort Time (ms)    Wall Time (ms)" 
+        << std::endl;
+    out_file << backend << "    " << timing.files << "    " 
+        << timing.io.operations << "    " << timing.io.syscalls << "    "
+        << per_file << "    " << timing.io.wait_time << "    " 
+        << timing.sort_time << "    " << timing.wall_time << std::endl;
+    out_file.close();
+
+    std::cout << "I/O (" << backend << "): " << timing.io.syscalls 
+        << " system calls for " << timing.files << " files (" << per_file
+        << " per file), " << timing.io.wait_time << " ms waiting, " 
+        << timing.sort_time << " ms sorting" << std::endl;
+    return 1;
+}
+
+int save_allocation_stats(const std::string out_dir, 
+    const AllocationStats &stats, const std::size_t files, const bool arena) {
+    /**
+     * Writes the heap allocations made while the input files were read, 
+     *  sorted and written
+     *
+     * Parameters:
+     *      out_dir (string)            :   output directory
+     *      stats (AllocationStats)     :   allocations made by the run
+     *      files (size_t)              :   number of input files
+     *      arena (bool)                :   whether --arena was used
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+
+    std::ofstream out_file(fs::path(out_dir+"/Azeem_Musa_allocations.txt"));
+    if (!out_file) {
+        std::cerr << "Error Opening Allocations Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    out_file << "Mode    Files    Allocations    Allocated (MB)"
+        << "    Allocations/File    Huge Page Buffers    Huge Pages (MB)" 
+        << std::endl;
+    out_file << (arena ? "arena" : "default") << "    " << files << "    ";
+    if constexpr (instrument_enabled) {
+        out_file << stats.count << "    " << stats.bytes / 1e6 << "    " 
+            << ((files > 0) ? static_cast<double>(stats.count) / files : 0);
+    }
+    else {
+        // operator new is only replaced in instrumented builds
+        out_file << "n/a    n/a    n/a";
+    }
+    out_file << "    " << stats.huge_buffers << "    " 
+        << stats.huge_bytes / 1e6 << std::endl;
+    out_file.close();
+    return 1;
+}
+
+std::uint64_t read_cycle_counter() {
+    /**
+     * Reads the CPU time stamp counter on x86, or a nanosecond clock on other
+     *  architectures
+     * 
+     * Returns:
+     *      uint64_t    :   current cycle count
+     */
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+// QuickSort Functions
+
+template <typename T, typename Compare, typename Index>
+#ifdef QUICKSORT_INSTRUMENT
+QuickSort<T, Compare, Index>::QuickSort(const Compare &comp) 
+    : comp(comp, &counters.comparisons) {
+#else
+QuickSort<T, Compare, Index>::QuickSort(const Compare &comp) : comp(comp) {
+#endif
+    /**
+     * Default Constructor
+     * 
+     * Initialize A as empty vector
+     * Seeds the pivot generator with a random seed (see set_seed)
+     * 
+     * Parameters:
+     *      comp (Compare)  :   ordering used to sort A
+     */
+    A = std::vector<T>();
+    engine = Engine::classic;
+    simd_level = detect_simd_level();
+    radix_bits = 0;
+    presort = true;
+    total_order = false;
+    nan_policy = NanPolicy::last;
+    arena = false;
+    pool = nullptr;
+    parse_time = 0;
+    parse_bytes = 0;
+    timed_values = 0;
+    depth_start = 0;
+    write_mode = WriteMode::buffered;
+    output_format = FileFormat::ascii;
+    seed = random_seed();           // Used for random pivot generation
+    rng.seed(seed);
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::read_file(const std::string &filename){
     /**
      * Reads a file from a given filename and populates the "A" vector
+     * Arithmetic types memory-map the file and parse it in place with 
+     *  std::from_chars, or copy the payload of a binary file (see
+     *  BinaryFormat.h), other types are read with operator>>
+     * Records the parse time and file size
+     * 
+     * Input file
+     *  - File containing numbers of type T seperated by whitespace, or a
+     *    binary file of any element type (converted to T)
+     * 
+     * Parameters:
+     *      filename (string)   :   name of file to read values from
+     * 
+     * Returns:
+     *      int :   Returns 1 if file reading was successful, 0 if not
+     */
+
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, read_counters);
+#endif
+    auto parse_start = std::chrono::steady_clock::now();
+    if (arena) {
+        A.clear();                      // Reuse the capacity of "A"
+    }
+    else {
+        A = std::vector<T>();           // Initialize new array
+    }
+    parse_bytes = 0;
+
+    if constexpr (std::is_arithmetic_v<T>) {
+        // Open and map file
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error Opening Input File" << std::endl;
+            return 0;   // return 0 to indicate failure
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            parse_bytes = st.st_size;
+            void *data = mmap(nullptr, parse_bytes, PROT_READ, MAP_PRIVATE, 
+                fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                std::cerr << "Error Mapping Input File" << std::endl;
+                return 0;   // return 0 to indicate failure
+            }
+            madvise(data, parse_bytes, MADV_SEQUENTIAL);
+            load_bytes(static_cast<const char *>(data), parse_bytes);
+            munmap(data, parse_bytes);
+        }
+        close(fd);
+    }
+    else {
+        std::string line;                   // line of input file
+        T value;                            // each value read from file
+
+        // Open file
+        std::ifstream in_file(filename);    // Input file stream
+        if (!in_file) {
+            std::cerr << "Error Opening Input File" << std::endl;
+            return 0;   // return 0 to indicate failure
+        }
+
+        // Get each line of input file 
+        while(std::getline(in_file, line)) { 
+            parse_bytes += line.size() + 1;
+            std::istringstream iss(line);   // Delim file line by whitespace
+            while (iss >> value) {
+                A.push_back(value);         // add each value to vector
+            }
+        }
+        in_file.close();
+    }
+
+    parse_time = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - parse_start).count();
+
+    // Check if file was empty or did not exist
+    if (A.size() == 0) {
+        std::cerr << "Input file is empty or does not exist - array not populated" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::load_bytes(const char *first, 
+    const std::size_t size) {
+    /**
+     * Fills "A" from the contents of a binary or ASCII file. A binary file 
+     *  that fails its checks leaves "A" empty
+     * 
+     * Parameters:
+     *      first (const char *)    :   start of the file contents
+     *      size (size_t)           :   size of the file
+     */
+    if (is_binary_file(first, size)) {
+        if (!load_binary(first, size)) {
+            A = std::vector<T>();   // Reject the whole file
+        }
+    }
+    else {
+        parse_buffer(first, first + size);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::read_bytes(const char *first, 
+    const std::size_t size) {
+    /**
+     * Populates the "A" vector from the contents of a file that the caller
+     *  read (see AsyncIO.h), like read_file does from a mapped file
+     * Records the parse time and file size
+     * 
+     * Parameters:
+     *      first (const char *)    :   start of the file contents
+     *      size (size_t)           :   size of the file
+     * 
+     * Returns:
+     *      int :   Returns 1 if values were read, 0 if not
+     */
+    static_assert(std::is_arithmetic_v<T>,
+        "read_bytes parses arithmetic types only");
+
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, read_counters);
+#endif
+    auto parse_start = std::chrono::steady_clock::now();
+    if (arena) {
+        A.clear();                      // Reuse the capacity of "A"
+    }
+    else {
+        A = std::vector<T>();           // Initialize new array
+    }
+    parse_bytes = size;
+    if (size > 0) {
+        load_bytes(first, size);
+    }
+    parse_time = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - parse_start).count();
+
+    if (A.size() == 0) {
+        std::cerr << "Input file is empty or does not exist - array not populated" << std::endl;
+        return 0;   // return 0 to indicate failure
+    }
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+const char *QuickSort<T, Compare, Index>::parse_buffer(const char *first, 
+    const char *last, const std::size_t max_values) {
+    /**
+     * Appends the whitespace separated values in [first, last) to "A" (see
+     *  TextFormat.h)
+     * "A" is reserved up front from the number of values in a sample at the
+     *  start of the buffer
+     * 
+     * Parameters:
+     *      first (const char *)    :   start of the text
+     *      last (const char *)     :   end of the text
+     *      max_values (size_t)     :   stop after this many values
+     * 
+     * Returns:
+     *      (const char *)  :   where parsing stopped, last unless max_values
+     *                          values were parsed first
+     */
+
+    if (first < last) {
+        std::size_t estimate = estimate_text_values(first, last);
+        grow(A, A.size() 
+            + std::min(estimate + estimate / 8 + 1, max_values));
+    }
+    return parse_text_values<T>(first, last, max_values, 
+        [this](const T value) { A.push_back(value); });
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::load_binary(const char *first, 
+    const std::size_t size) {
+    /**
+     * Fills "A" from a mapped binary file after checking its header and 
+     *  checksum
+     * 
+     * Parameters:
+     *      first (const char *)    :   start of the file
+     *      size (size_t)           :   size of the file
+     * 
+     * Returns:
+     *      int :   Returns 1 if the file was valid, 0 if not
+     */
+    BinaryHeader header;
+    if (!decode_binary_header(first, size, header)) {
+        return 0;
+    }
+    const char *payload = first + binary_header_size;
+    if (binary_checksum(payload, size - binary_header_size) 
+        != header.checksum) {
+        std::cerr << "Binary input file checksum mismatch" << std::endl;
+        return 0;
+    }
+    grow(A, header.count);
+    A.resize(header.count);
+    decode_binary_values(payload, header, A.data());
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_array(const std::vector<T> &values) {
+    /**
+     * Replaces "A" with a copy of the given values so that arrays that were
+     *  not read from a file can be sorted
+     * In arena mode the copy reuses the capacity of "A"
+     * 
+     * Parameters:
+     *      values (const vector<T> &)  :   values to sort
+     */
+    if (arena) {
+        A.clear();
+    }
+    else {
+        A = std::vector<T>();
+    }
+    grow(A, values.size());
+    A.assign(values.begin(), values.end());
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_array(std::vector<T> &&values) {
+    /**
+     * Replaces "A" with the given values without copying them
+     * 
+     * Parameters:
+     *      values (vector<T> &&)   :   values to sort
+     */
+    A = std::move(values);
+}
+
+template <typename T, typename Compare, typename Index>
+const std::vector<T> &QuickSort<T, Compare, Index>::get_array() const {
+    /**
+     * Returns:
+     *      (const vector<T> &) :   the current contents of "A"
+     */
+    return A;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_engine(const Engine engine) {
+    /**
+     * Selects the engine used by quick_sort()
+     * 
+     * Parameters:
+     *      engine (Engine) :   classic, hybrid, three_way, block, simd, 
+     *                          parallel, radix, merge or auto_select
+     */
+    this->engine = engine;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_simd_level(const SimdLevel level) {
+    /**
+     * Limits the instruction set used by the simd engine
+     * Levels the CPU does not support are lowered to the widest supported one
+     * 
+     * Parameters:
+     *      level (SimdLevel)   :   avx512, avx2 or scalar
+     */
+    simd_level = std::min(level, detect_simd_level());
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_radix_bits(const unsigned bits) {
+    /**
+     * Sets the digit width of the radix engine
+     * 
+     * Parameters:
+     *      bits (unsigned) :   8 or 11 bits per pass, 0 to pick 11 for large
+     *                          arrays of 8-byte keys and 8 otherwise
+     */
+    radix_bits = radix_digit_bits_valid(bits) ? bits : 0;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_presort(const bool enabled) {
+    /**
+     * Turns the presortedness scan of quick_sort() on or off
+     * 
+     * Parameters:
+     *      enabled (bool)  :   scan for natural runs before sorting
+     */
+    presort = enabled;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_total_order(const bool enabled,
+    const NanPolicy nan) {
+    /**
+     * Turns the totalOrder mode of quick_sort() on or off. It applies to 
+     *  double and float keys in ascending order only
+     * 
+     * Parameters:
+     *      enabled (bool)      :   sort in IEEE 754 totalOrder
+     *      nan (NanPolicy)     :   put NaNs first, last, or drop them
+     */
+    total_order = enabled;
+    nan_policy = nan;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_seed(const std::uint64_t seed) {
+    /**
+     * Sets the seed of the pivot generator. Every sort or selection 
+     *  restarts the generator from it, so the same seed and input always 
+     *  give the same pivots
+     * 
+     * Parameters:
+     *      seed (uint64_t) :   seed of the pivot generator
+     */
+    this->seed = seed;
+    rng.seed(seed);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_arena(const bool enabled) {
+    /**
+     * Turns arena mode on or off. In arena mode read_file and set_array keep
+     *  the capacity of "A" and buffers of large arrays use huge pages
+     * 
+     * Parameters:
+     *      enabled (bool)  :   reuse buffer capacity across arrays
+     */
+    arena = enabled;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::grow(std::vector<T> &buffer, 
+    std::size_t n) {
+    /**
+     * Reserves room for n values in a buffer of this sorter
+     * In arena mode a buffer grows by at least half of its capacity, so 
+     *  files of slowly increasing size do not reallocate every time, and 
+     *  new buffers are advised to use huge pages before they are written
+     * 
+     * Parameters:
+     *      buffer (vector<T> &)    :   "A" or "scratch"
+     *      n (size_t)              :   number of values the buffer must hold
+     */
+    if (buffer.capacity() >= n) {
+        return;
+    }
+    if (arena) {
+        n = std::max(n, buffer.capacity() + buffer.capacity() / 2);
+    }
+    buffer.reserve(n);
+    if (arena) {
+        advise_huge_pages(buffer.data(), buffer.capacity() * sizeof(T));
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_write_mode(const WriteMode mode) {
+    /**
+     * Selects how write_file writes sorted files
+     * 
+     * Parameters:
+     *      mode (WriteMode)    :   buffered, writev or direct
+     */
+    write_mode = mode;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_output_format(const FileFormat format) {
+    /**
+     * Selects whether write_file writes ASCII or binary files
+     * 
+     * Parameters:
+     *      format (FileFormat) :   ascii or binary
+     */
+    output_format = format;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::set_thread_pool(ThreadPool *pool) {
+    /**
+     * Sets the threads used by the parallel engine
+     * Without a pool the parallel engine sorts on the calling thread only
+     * 
+     * Parameters:
+     *      pool (ThreadPool *) :   pool to run tasks on (not owned)
+     */
+    this->pool = pool;
+}
+
+template <typename T, typename Compare, typename Index>
+std::vector<T> QuickSort<T, Compare, Index>::release_array() {
+    /**
+     * Moves "A" out of the sorter without copying it, leaving "A" empty
+     * 
+     * Returns:
+     *      (vector<T>) :   the current contents of "A"
+     */
+    std::vector<T> values = std::move(A);
+    A = std::vector<T>();
+    return values;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::swap_array(std::vector<T> &values) {
+    /**
+     * Exchanges "A" with the given vector without copying either, so the 
+     *  sorter keeps a buffer to reuse for the next array
+     * 
+     * Parameters:
+     *      values (vector<T> &)    :   set to the current contents of "A"
+     */
+    A.swap(values);
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::quick_sort() {
+    /**
+     * Implements the QuickSort algorithm using the selected engine
+     *  - classic : Hoarse Partition Algorithm with random pivots
+     *  - hybrid  : introsort with median-of-3/ninther pivots, insertion sort
+     *              for small subarrays and a heap sort fallback
+     *  - three_way : hybrid engine with three way partitioning at every level
+     *  - block : hybrid engine with branchless block partitioning
+     *  - simd  : hybrid engine with vectorized partitioning and leaves
+     *  - parallel : hybrid engine on a work-stealing thread pool
+     *  - radix : LSD radix sort for arithmetic keys in ascending order, 
+     *            hybrid engine for other types and comparators
+     *  - merge : stable parallel merge sort
+     * With the totalOrder mode, floating point keys are sorted as integer
+     *  keys by total_order_sort instead
+     *  - auto_select : radix engine for large arrays, simd engine otherwise
+     * Unless presort is off, every engine except classic first checks for 
+     *  sorted, reversed or few-run input with sort_presorted
+     * Records start and end time of algorithm
+     * Algorithm is implemented in overloaded recursive function
+     * 
+     * Returns:
+     *      (int)   :   returns 1 to indicate success
+     * 
+     */
+
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+    start_time = std::chrono::steady_clock::now();     // Start timer
+    start_cycles = read_cycle_counter();
+    rng.seed(seed);                 // Same seed and input, same pivots
+    timed_values = A.size();
+
+    // QuickSort starting with first and last indices
+    Index n = static_cast<Index>(A.size());
+    depth_start = depth_limit_for(n);
+    int ret = 1;
+    if (total_order && std::is_floating_point_v<T> 
+        && std::is_same_v<Compare, std::less<T>>) {
+        // Also applies the NaN policy to a single value
+        total_order_sort();
+    }
+    else if (n < 2) {
+        // If array is empty or has only one element, do nothing
+    }
+    else if (presort && engine != Engine::classic && sort_presorted()) {
+        // Already sorted, reversed or merged from a few runs
+    }
+    else if (engine == Engine::merge) {
+        merge_sort();
+    }
+    else if (use_radix(n)) {
+        radix_sort();
+    }
+    else if (engine != Engine::classic) {
+        // Allow 2*floor(log2(n)) levels before falling back to heap sort
+        int depth_limit = depth_limit_for(n);
+        if (engine == Engine::parallel && pool != nullptr) {
+            // Only large arrays on more than one thread use the buffer
+            if (n >= parallel_partition_threshold && pool->size() > 1) {
+                grow(scratch, A.size());
+                scratch.resize(A.size());
+            }
+            else {
+                scratch.clear();
+            }
+            TaskGroup group;
+            parallel_sort(0, n-1, depth_limit, group);
+            pool->wait(group);
+        }
+        else {
+            intro_sort(0, n-1, depth_limit);
+        }
+    }
+    else {
+        ret = quick_sort(0, n-1);
+    }
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();       // Stop timer
+
+    return ret;
+}
+
+template <typename T, typename Compare, typename Index>
+bool QuickSort<T, Compare, Index>::sort_presorted() {
+    /**
+     * Splits "A" into natural runs: non-descending runs, and runs that 
+     *  start with a descent and continue while non-ascending, which are
+     *  reversed in place (equal values may change order, which quick sort 
+     *  never preserved anyway). The stable merge engine only reverses 
+     *  strictly descending runs
+     * Gives up as soon as a run past presort_max_runs starts, so random 
+     *  input is only scanned for a few dozen values
+     * One run is already sorted. Two or more are merged in pairs, moving
+     *  between "A" and "scratch", in ceil(log2(runs)) passes
+     * 
+     * Returns:
+     *      bool    :   true if "A" is sorted, false if it has too many runs
+     *                  (it is still a permutation of the input)
+     */
+
+    const std::size_t n = A.size();
+    std::array<std::size_t, presort_max_runs + 1> bounds;
+    std::size_t runs = 0;
+    for (std::size_t i = 0; i < n; ) {
+        if (runs == presort_max_runs) {
+            return false;
+        }
+        bounds[runs++] = i;
+        std::size_t j = i + 1;
+        if (j < n && comp(A[j], A[j-1])) {
+            while (j < n && (engine == Engine::merge ? comp(A[j], A[j-1])
+                : !comp(A[j-1], A[j]))) {
+                j++;
+            }
+            std::reverse(A.begin() + i, A.begin() + j);
+        }
+        else {
+            while (j < n && !comp(A[j], A[j-1])) {
+                j++;
+            }
+        }
+        i = j;
+    }
+    bounds[runs] = n;
+    if (runs == 1) {
+        return true;
+    }
+
+    // Merge neighbouring runs until one is left
+    grow(scratch, n);
+    scratch.resize(n);
+    T *src = A.data();
+    T *dst = scratch.data();
+    while (runs > 1) {
+        std::size_t merged = 0;
+        std::size_t r = 0;
+        for (; r + 1 < runs; r += 2) {
+            std::merge(std::make_move_iterator(src + bounds[r]),
+                std::make_move_iterator(src + bounds[r+1]),
+                std::make_move_iterator(src + bounds[r+1]),
+                std::make_move_iterator(src + bounds[r+2]),
+                dst + bounds[r], comp);
+            bounds[merged++] = bounds[r];
+        }
+        if (r < runs) {
+            // Odd run out, copied to keep every run in the same buffer
+            std::move(src + bounds[r], src + n, dst + bounds[r]);
+            bounds[merged++] = bounds[r];
+        }
+        bounds[merged] = n;
+        runs = merged;
+        std::swap(src, dst);
+    }
+    if (src != A.data()) {
+        std::move(src, src + n, A.data());
+    }
+    return true;
+}
+
+template <typename T, typename Compare, typename Index>
+bool QuickSort<T, Compare, Index>::use_radix(const Index n) const {
+    /**
+     * Parameters:
+     *      n (Index)   :   number of values to sort
+     * 
+     * Returns:
+     *      bool    :   true if the selected engine sorts n values of T with
+     *                  radix_sort. Only ascending arithmetic keys have a 
+     *                  radix key
+     *                   - radix : always
+     *                   - auto_select : integer keys from 
+     *                     radix_auto_int_threshold values. Floating point
+     *                     keys from radix_auto_float_threshold values, unless
+     *                     the AVX-512 partition of the simd engine is faster
+     */
+    if constexpr (radix_key_v<T> && std::is_same_v<Compare, std::less<T>>) {
+        if (engine == Engine::auto_select) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return simd_level != SimdLevel::avx512 
+                    && n >= radix_auto_float_threshold;
+            }
+            else {
+                return n >= radix_auto_int_threshold;
+            }
+        }
+        return engine == Engine::radix;
+    }
+    else {
+        (void)n;
+        return false;
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::merge_sort() {
+    /**
+     * Merge engine - sorts "A" stably with parallel_merge_sort from 
+     *  MergeSort.h on the thread pool, using "scratch" as the buffer every
+     *  merge moves the values into and back
+     */
+    grow(scratch, A.size());
+    scratch.resize(A.size());
+    parallel_merge_sort(A.data(), A.size(), scratch.data(), comp, pool);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::total_order_sort() {
+    /**
+     * totalOrder mode - sorts floating point keys that may hold NaNs
+     *  1. NaNs are moved out of "A" in input order
+     *  2. The other values are mapped to unsigned integer keys in totalOrder
+     *     and the keys are sorted by a sorter with this sorter's engine and
+     *     settings, which compares them as integers. It is created by the
+     *     first sort and keeps its buffers for the next ones
+     *  3. The keys are mapped back into "A", and the NaNs are put first, 
+     *     last or dropped by the NaN policy
+     */
+    if constexpr (std::is_floating_point_v<T>) {
+        using U = radix_bits_t<T>;
+        std::vector<T> nans;
+        std::size_t m = 0;
+        for (std::size_t i = 0; i < A.size(); i++) {
+            if (std::isnan(A[i])) {
+                nans.push_back(A[i]);
+            }
+            else {
+                A[m++] = A[i];
+            }
+        }
+
+        total_keys.resize(m);       // keeps its capacity between sorts
+        for (std::size_t i = 0; i < m; i++) {
+            total_keys[i] = total_order_key(A[i]);
+        }
+        if (!key_sorter) {
+            key_sorter = std::make_unique<QuickSort<U, std::less<U>, Index>>();
+        }
+        QuickSort<U, std::less<U>, Index> &sorter = *key_sorter;
+        sorter.set_engine(engine);
+        sorter.set_simd_level(simd_level);
+        sorter.set_radix_bits(radix_bits);
+        sorter.set_presort(presort);
+        sorter.set_arena(arena);
+        sorter.set_seed(seed);
+        sorter.set_thread_pool(pool);
+        sorter.swap_array(total_keys);
+        sorter.quick_sort();
+        sorter.swap_array(total_keys);
+
+        T *sorted = A.data();
+        if (nan_policy == NanPolicy::first) {
+            std::copy(nans.begin(), nans.end(), A.begin());
+            sorted += nans.size();
+        }
+        else if (nan_policy == NanPolicy::last) {
+            std::copy(nans.begin(), nans.end(), A.begin() + m);
+        }
+        else {
+            A.resize(m);
+        }
+        for (std::size_t i = 0; i < m; i++) {
+            sorted[i] = total_order_value<T>(total_keys[i]);
+        }
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+TotalOrderLess<T, Compare> QuickSort<T, Compare, Index>::merge_order() const {
+    /**
+     * Returns:
+     *      (TotalOrderLess<T, Compare>)    :   order of the sorted runs of 
+     *                                          the external and streaming
+     *                                          sorts, totalOrder if enabled
+     */
+    return TotalOrderLess<T, Compare>{comp, total_order, nan_policy};
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::radix_sort() {
+    /**
+     * Radix engine - sorts "A" with the LSD radix sort from RadixSort.h,
+     *  using "scratch" as the buffer of each pass
+     * Without a set digit width, 8-byte keys use 11-bit digits (6 passes 
+     *  instead of 8) from radix_wide_digit_threshold values; smaller arrays
+     *  and 4-byte keys use 8-bit digits, whose counts stay in L1 cache
+     */
+    if constexpr (radix_key_v<T>) {
+        unsigned bits = radix_bits;
+        if (bits == 0) {
+            bits = (sizeof(T) == 8 
+                && static_cast<Index>(A.size()) >= radix_wide_digit_threshold)
+                ? 11 : 8;
+        }
+        grow(scratch, A.size());
+        scratch.resize(A.size());
+        radix_sort_bits(A.data(), A.size(), scratch.data(), bits);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::quick_sort(const Index l, const Index r,
+    const int depth) {
+    /**
+     * Implements the QuickSort algorithm to sort "A"
+     * 
+     * Parameters:
+     *  l (Index)       :   Index to start subarray
+     *  r (Index)       :   Index to stop subarray
+     *  depth (int)     :   Recursion depth of the subarray, from 1
+     * 
+     * Returns:
+     *  (int)   : returns 1 to indicate success
+     */
+
+    Index s = 0;    // Partition index
+    // Continue until indices overlap
+    if (l < r) {
+        // Parition array and get index to split
+        s = hoarse_partition(l, r);
+        count_partition(l, r, s, s, depth);
+        quick_sort(l, s-1, depth+1);    // Sort left partition
+        quick_sort(s+1, r, depth+1);    // Sort right partition
+    }
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::select(const std::size_t k) {
+    /**
+     * Moves the k-th smallest value (0-based) of "A" to A[k], with no larger
+     *  value before it and no smaller value after it (like nth_element)
+     * Quickselect on the partition kernel of the selected engine that only 
+     *  follows the side holding k, with a heap sort fallback after 
+     *  2*log2(n) levels (introselect)
+     * Records start and end time of the selection
+     * 
+     * Parameters:
+     *      k (size_t)  :   rank to select
+     * 
+     * Returns:
+     *      (int)   :   returns 1 to indicate success, 0 if k is out of range
+     */
+
+    if (k >= A.size()) {
+        std::cerr << "Rank out of range" << std::endl;
+        return 0;
+    }
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+    start_time = std::chrono::steady_clock::now();     // Start timer
+    start_cycles = read_cycle_counter();
+    rng.seed(seed);                 // Same seed and input, same pivots
+    timed_values = A.size();
+    depth_start = depth_limit_for(static_cast<Index>(A.size()));
+
+    Index n = static_cast<Index>(A.size());
+    intro_select(0, n-1, static_cast<Index>(k), depth_limit_for(n));
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();       // Stop timer
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::multi_select(std::vector<std::size_t> ranks) {
+    /**
+     * Moves the values of several ranks (e.g. the quantiles of "A") to their
+     *  sorted positions in one pass: after each partition, only the sides
+     *  that still hold requested ranks are partitioned further
+     * Records start and end time of the selection
+     * 
+     * Parameters:
+     *      ranks (vector<size_t>)  :   ranks to select, in any order
+     * 
+     * Returns:
+     *      (int)   :   returns 1 to indicate success, 0 if a rank is out of 
+     *                  range
+     */
+
+    std::vector<Index> ks;
+    for (auto k : ranks) {
+        if (k >= A.size()) {
+            std::cerr << "Rank out of range" << std::endl;
+            return 0;
+        }
+        ks.push_back(static_cast<Index>(k));
+    }
+    std::sort(ks.begin(), ks.end());
+    ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+    start_time = std::chrono::steady_clock::now();     // Start timer
+    start_cycles = read_cycle_counter();
+    rng.seed(seed);                 // Same seed and input, same pivots
+    timed_values = A.size();
+    depth_start = depth_limit_for(static_cast<Index>(A.size()));
+
+    Index n = static_cast<Index>(A.size());
+    multi_select(0, n-1, ks.data(), ks.data() + ks.size(), depth_limit_for(n));
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();       // Stop timer
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::partial_sort(const std::size_t k) {
+    /**
+     * Sorts the k smallest values of "A" into A[0..k-1] (top-k); the order
+     *  of the rest is unspecified
+     * Selects rank k-1, then sorts only the values before it
+     * Records start and end time of the partial sort
+     * 
+     * Parameters:
+     *      k (size_t)  :   number of smallest values to sort
+     * 
+     * Returns:
+     *      (int)   :   returns 1 to indicate success, 0 if k is larger than 
+     *                  "A"
+     */
+
+    if (k > A.size()) {
+        std::cerr << "Rank out of range" << std::endl;
+        return 0;
+    }
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+    start_time = std::chrono::steady_clock::now();     // Start timer
+    start_cycles = read_cycle_counter();
+    rng.seed(seed);                 // Same seed and input, same pivots
+    timed_values = A.size();
+    depth_start = depth_limit_for(static_cast<Index>(A.size()));
+
+    if (k > 0) {
+        Index n = static_cast<Index>(A.size());
+        Index last = static_cast<Index>(k) - 1;
+        intro_select(0, n-1, last, depth_limit_for(n));
+        if (engine == Engine::classic) {
+            quick_sort(0, last-1);
+        }
+        else {
+            intro_sort(0, last-1, depth_limit_for(last));
+        }
+    }
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();       // Stop timer
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::intro_select(Index l, Index r, 
+    const Index k, int depth_limit) {
+    /**
+     * Moves the k-th smallest value of A[l..r] to A[k]
+     * 
+     * Parameters:
+     *  l (Index)           :   Index to start subarray
+     *  r (Index)           :   Index to stop subarray
+     *  k (Index)           :   Index to select, l <= k <= r
+     *  depth_limit (int)   :   Partition levels left before heap sort is used
+     */
+
+    Index lt;       // First index of the values equal to the pivot
+    Index gt;       // Last index of the values equal to the pivot
+    while (r - l + 1 > insertion_sort_threshold) {
+        if (depth_limit == 0) {
+            // Too many unbalanced partitions - guarantee O(n log n)
+            heap_sort(l, r);
+            return;
+        }
+        depth_limit--;
+
+        partition_step(l, r, lt, gt);
+        count_partition(l, r, lt, gt, depth_start - depth_limit);
+        if (k < lt) {
+            r = lt-1;
+        }
+        else if (k > gt) {
+            l = gt+1;
+        }
+        else {
+            return;     // k is in the band equal to the pivot
+        }
+    }
+    insertion_sort(l, r);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::multi_select(Index l, Index r, 
+    const Index *first, const Index *last, int depth_limit) {
+    /**
+     * Moves the values of the sorted ranks [first, last) within A[l..r] to
+     *  their sorted positions
+     * Recurses into the side with fewer ranks and loops on the other one
+     * 
+     * Parameters:
+     *  l (Index)               :   Index to start subarray
+     *  r (Index)               :   Index to stop subarray
+     *  first (const Index *)   :   first rank to select
+     *  last (const Index *)    :   end of the ranks to select
+     *  depth_limit (int)       :   Partition levels left before heap sort 
+     */
+
+    Index lt;       // First index of the values equal to the pivot
+    Index gt;       // Last index of the values equal to the pivot
+    while (first != last && r - l + 1 > insertion_sort_threshold) {
+        if (depth_limit == 0) {
+            // Too many unbalanced partitions - guarantee O(n log n)
+            heap_sort(l, r);
+            return;
+        }
+        depth_limit--;
+
+        partition_step(l, r, lt, gt);
+        count_partition(l, r, lt, gt, depth_start - depth_limit);
+        const Index *below = std::lower_bound(first, last, lt);
+        const Index *above = std::upper_bound(below, last, gt);
+        if (below - first < last - above) {
+            multi_select(l, lt-1, first, below, depth_limit);
+            l = gt+1;
+            first = above;
+        }
+        else {
+            multi_select(gt+1, r, above, last, depth_limit);
+            r = lt-1;
+            last = below;
+        }
+    }
+    if (first != last) {
+        insertion_sort(l, r);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::hoarse_partition(const Index l, 
+    const Index r) {
+    /**
+     * Implements a hoarse partition on a provided subarray
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (Index)    :   Index that split occurs
+     */
+
+    // Generate random pivot and move the value to beginning of subarray
+    swap(l, generate_random_int(l, r+1));
+    const T p = A[l];   // Pivot keeps the element type (no truncation)
+    
+    Index i = l;      // Start i at left index after pivot
+    Index j = r+1;    // Start j at right index
+
+    // Repeat iteration until i and j overlap
+    while (i < j) {
+        do i++; while(comp(A[i], p) && i < r);    // Increment i until a value greater than p is reached
+        do j--; while(comp(p, A[j]) && j > l);    // Decrement j until a value less than p is reached
+        swap(i, j);
+    }
+    swap(i, j);          // Undo last swap when i >= j
+    swap(l, j);          // Swap pivot with j, the new partition
+
+    return j;           // Return the partition index
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::partition_step(const Index l, 
+    const Index r, Index &lt, Index &gt) {
+    /**
+     * Partitions A[l..r] once with the kernel of the selected engine
+     *  - classic   : hoarse_partition with a random pivot
+     *  - otherwise : median-of-3/ninther pivot, then a three way partition
+     *                for the three_way engine or a pivot sample with 
+     *                duplicates, else the block, vector or two way kernel
      * 
-     * Input file
-     *  - File containing floating point numbers seperated by whitespace
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     *      lt (Index &):   set to the first index of values equal to pivot
+     *      gt (Index &):   set to the last index of values equal to pivot
+     */
+
+    if (engine == Engine::classic) {
+        lt = gt = hoarse_partition(l, r);
+        return;
+    }
+    bool duplicates = choose_pivot(l, r);
+    if (engine == Engine::three_way || duplicates) {
+        three_way_partition(l, r, lt, gt);
+    }
+    else if (engine == Engine::block || engine == Engine::parallel) {
+        lt = gt = block_partition(l, r);
+    }
+    else if (engine == Engine::simd || engine == Engine::auto_select) {
+        lt = gt = vector_partition(l, r);
+    }
+    else {
+        lt = gt = two_way_partition(l, r);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::depth_limit_for(const Index n) {
+    /**
+     * Returns:
+     *      int :   2*floor(log2(n)) partition levels allowed before the 
+     *              heap sort fallback
+     */
+    int depth_limit = 0;
+    for (Index k = n; k > 1; k >>= 1) {
+        depth_limit += 2;
+    }
+    return depth_limit;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::intro_sort(Index l, Index r, int depth_limit) {
+    /**
+     * Hybrid engine - sorts A[l..r] with introsort
+     * Recurses into the smaller partition and loops on the larger one, so
+     *  the stack depth stays O(log n)
+     * The three_way engine always removes the band of values equal to the
+     *  pivot from further recursion, the hybrid engine only does so when the
+     *  pivot sample contained duplicates
+     * 
+     * Parameters:
+     *  l (Index)           :   Index to start subarray
+     *  r (Index)           :   Index to stop subarray
+     *  depth_limit (int)   :   Partition levels left before heap sort is used
+     */
+
+    Index lt;       // First index of the values equal to the pivot
+    Index gt;       // Last index of the values equal to the pivot
+    while (r - l + 1 > insertion_sort_threshold) {
+        if (depth_limit == 0) {
+            // Too many unbalanced partitions - guarantee O(n log n)
+            heap_sort(l, r);
+            return;
+        }
+        depth_limit--;
+
+        partition_step(l, r, lt, gt);
+        count_partition(l, r, lt, gt, depth_start - depth_limit);
+
+        if (lt - l < r - gt) {
+            intro_sort(l, lt-1, depth_limit);
+            l = gt+1;
+        }
+        else {
+            intro_sort(gt+1, r, depth_limit);
+            r = lt-1;
+        }
+    }
+
+    // l can be r+1 here, so the leaf is addressed through A.data()
+    if constexpr (simd_key_v<T> && std::is_same_v<Compare, std::less<T>>) {
+        if ((engine == Engine::simd || engine == Engine::auto_select) 
+            && simd_level != SimdLevel::scalar && r > l
+            && simd_sort_leaf(A.data() + l, r - l + 1, simd_level)) {
+            return;
+        }
+    }
+    insertion_sort(l, r);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::parallel_sort(Index l, Index r, 
+    int depth_limit, TaskGroup &group) {
+    /**
+     * Parallel engine - sorts A[l..r] on the thread pool
+     * After each partition the smaller side becomes a task and this thread
+     *  continues with the larger side. Subarrays below the grain size are
+     *  sorted with the serial hybrid engine (block partitioning)
+     * 
+     * Parameters:
+     *  l (Index)           :   Index to start subarray
+     *  r (Index)           :   Index to stop subarray
+     *  depth_limit (int)   :   Partition levels left before heap sort is used
+     *  group (TaskGroup &) :   Group the spawned tasks are added to
+     */
+
+    Index lt;       // First index of the values equal to the pivot
+    Index gt;       // Last index of the values equal to the pivot
+    while (r - l + 1 > parallel_grain) {
+        if (depth_limit == 0) {
+            heap_sort(l, r);
+            return;
+        }
+        depth_limit--;
+
+        bool duplicates = choose_pivot(l, r);
+        if (duplicates) {
+            three_way_partition(l, r, lt, gt);
+        }
+        else if (r - l + 1 >= parallel_partition_threshold 
+            && !scratch.empty()) {
+            lt = gt = parallel_partition(l, r);
+        }
+        else {
+            lt = gt = block_partition(l, r);
+        }
+        count_partition(l, r, lt, gt, depth_start - depth_limit);
+
+        if (lt - l < r - gt) {
+            pool->run(group, [this, l, lt, depth_limit, &group]() {
+                parallel_sort(l, lt-1, depth_limit, group);
+            });
+            l = gt+1;
+        }
+        else {
+            pool->run(group, [this, r, gt, depth_limit, &group]() {
+                parallel_sort(gt+1, r, depth_limit, group);
+            });
+            r = lt-1;
+        }
+    }
+    intro_sort(l, r, depth_limit);
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::parallel_partition(const Index l, 
+    const Index r) {
+    /**
+     * Parallel engine - partitions A[l..r] around the pivot at A[l] with
+     *  every thread of the pool
+     *  1. Each thread counts the values less than the pivot in its chunk
+     *  2. A prefix sum over the counts gives each chunk its output ranges
+     *  3. Each thread scatters its chunk into "scratch" and copies its share
+     *     of the result back into A
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (Index)    :   Index that split occurs (pivot is in its final place)
+     */
+
+    const T p = A[l];
+    const Index first = l+1;
+    const Index n = r - l;
+    const Index chunks = pool->size();
+    std::vector<Index> less_counts(chunks, 0);
+    auto chunk_start = [&](Index k) { return first + n * k / chunks; };
+
+    // Count values less than the pivot in each chunk
+    TaskGroup count_group;
+    for (Index k = 0; k < chunks; k++) {
+        pool->run(count_group, [&, k]() {
+            Index count = 0;
+            for (Index i = chunk_start(k); i < chunk_start(k+1); i++) {
+                count += comp(A[i], p);
+            }
+            less_counts[k] = count;
+        });
+    }
+    pool->wait(count_group);
+
+    // Scatter each chunk to its output ranges in scratch
+    Index total_less = 0;
+    for (Index k = 0; k < chunks; k++) {
+        total_less += less_counts[k];
+    }
+    TaskGroup scatter_group;
+    Index less_offset = first;
+    Index greater_offset = first + total_less;
+    for (Index k = 0; k < chunks; k++) {
+        pool->run(scatter_group, [&, k, less_offset, greater_offset]() {
+            Index li = less_offset;
+            Index gi = greater_offset;
+            for (Index i = chunk_start(k); i < chunk_start(k+1); i++) {
+                if (comp(A[i], p)) {
+                    scratch[li++] = std::move(A[i]);
+                }
+                else {
+                    scratch[gi++] = std::move(A[i]);
+                }
+            }
+        });
+        less_offset += less_counts[k];
+        greater_offset += (chunk_start(k+1) - chunk_start(k)) - less_counts[k];
+    }
+    pool->wait(scatter_group);
+
+    // Copy the partitioned values back
+    TaskGroup copy_group;
+    for (Index k = 0; k < chunks; k++) {
+        pool->run(copy_group, [&, k]() {
+            std::move(scratch.begin() + chunk_start(k), 
+                scratch.begin() + chunk_start(k+1), A.begin() + chunk_start(k));
+        });
+    }
+    pool->wait(copy_group);
+
+    Index m = first + total_less;
+    swap_values(A[l], A[m-1]);    // Move pivot to the partition index
+    return m-1;
+}
+
+template <typename T, typename Compare, typename Index>
+bool QuickSort<T, Compare, Index>::choose_pivot(const Index l, const Index r) {
+    /**
+     * Hybrid engine - moves the median of 3 elements, or Tukey's ninther for
+     *  larger subarrays, to the beginning of A[l..r]
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (bool)  :   true if the sampled values contained duplicates
+     */
+
+    Index mid = l + (r - l) / 2;
+    bool duplicates = false;
+    if (r - l + 1 > ninther_threshold) {
+        duplicates |= sort3(l, mid, r);
+        duplicates |= sort3(l+1, mid-1, r-1);
+        duplicates |= sort3(l+2, mid+1, r-2);
+        duplicates |= sort3(mid-1, mid, mid+1);
+    }
+    else {
+        duplicates = sort3(l, mid, r);
+    }
+    swap_values(A[l], A[mid]);
+    return duplicates;
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::two_way_partition(const Index l, 
+    const Index r) {
+    /**
+     * Hybrid engine - partitions A[l..r] around the pivot at A[l]
+     * Unlike hoarse_partition, no swap has to be undone when i and j cross
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (Index)    :   Index that split occurs (pivot is in its final place)
+     */
+
+    const T p = A[l];
+
+    Index i = l;
+    Index j = r+1;
+    while (true) {
+        do i++; while(i < r && comp(A[i], p));  // A[l] == p stops j at l
+        do j--; while(comp(p, A[j]));
+        if (i >= j) {
+            break;
+        }
+        swap_values(A[i], A[j]);
+    }
+    swap_values(A[l], A[j]);      // Move pivot to the partition index
+
+    return j;
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::block_partition(const Index l, 
+    const Index r) {
+    /**
+     * Block engine - branchless partition of A[l..r] around the pivot at A[l]
+     *  (Edelkamp and Weiss, BlockQuicksort)
+     * The offsets of misplaced values in a block at each end are buffered
+     *  with comparison results used as integers instead of branches, then
+     *  misplaced pairs are swapped in bulk. The leftover middle is finished
+     *  with a branchless Lomuto scan
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (Index)    :   Index that split occurs (pivot is in its final place)
+     */
+
+    const T p = A[l];
+    const Index block = partition_block_size;
+    unsigned char offsets_l[partition_block_size];
+    unsigned char offsets_r[partition_block_size];
+
+    // A[l+1..first-1] < p and A[last..r] >= p, [first, last) is unsorted
+    Index first = l+1;
+    Index last = r+1;
+    Index num_l = 0, num_r = 0;         // Buffered offsets left to swap
+    Index start_l = 0, start_r = 0;     // First unused buffered offset
+
+    while (last - first > 2*block) {
+        // Find values >= p in the left block and < p in the right block
+        if (num_l == 0) {
+            start_l = 0;
+            for (Index k = 0; k < block; k++) {
+                offsets_l[num_l] = static_cast<unsigned char>(k);
+                num_l += !comp(A[first+k], p);
+            }
+        }
+        if (num_r == 0) {
+            start_r = 0;
+            for (Index k = 0; k < block; k++) {
+                offsets_r[num_r] = static_cast<unsigned char>(k);
+                num_r += comp(A[last-1-k], p);
+            }
+        }
+
+        // Swap misplaced pairs
+        Index num = std::min(num_l, num_r);
+        for (Index k = 0; k < num; k++) {
+            swap_values(A[first + offsets_l[start_l+k]], 
+                A[last-1 - offsets_r[start_r+k]]);
+        }
+        num_l -= num;
+        num_r -= num;
+        start_l += num;
+        start_r += num;
+
+        // Only advance past a block once all of its values are placed
+        if (num_l == 0) {
+            first += block;
+        }
+        if (num_r == 0) {
+            last -= block;
+        }
+    }
+
+    // Finish the unsorted middle with a branchless Lomuto partition
+    Index m = first;
+    for (Index k = first; k < last; k++) {
+        T value = std::move(A[k]);
+        bool less = comp(value, p);
+        A[k] = std::move(A[m]);
+        A[m] = std::move(value);
+        m += less;
+    }
+    swap_values(A[l], A[m-1]);    // Move pivot to the partition index
+
+    return m-1;
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::vector_partition(const Index l, 
+    const Index r) {
+    /**
+     * Simd engine - partitions A[l..r] around the pivot at A[l] with the
+     *  AVX-512 or AVX2 kernel from SimdPartition.h
+     * Element types without a vector kernel, custom comparators and CPUs
+     *  without AVX2 use block_partition
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     * 
+     * Returns:
+     *  (Index)    :   Index that split occurs (pivot is in its final place)
+     */
+
+    if constexpr (simd_key_v<T> && std::is_same_v<Compare, std::less<T>>) {
+        if (simd_level != SimdLevel::scalar) {
+            Index m = l+1 + simd_partition(&A[l+1], r - l, A[l], simd_level);
+            swap_values(A[l], A[m-1]);    // Move pivot to the partition index
+            return m-1;
+        }
+    }
+    return block_partition(l, r);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::three_way_partition(const Index l, 
+    const Index r, Index &lt, Index &gt) {
+    /**
+     * Bentley-McIlroy three way partition of A[l..r] around the pivot at A[l]
+     * Values equal to the pivot are parked at both ends while scanning and
+     *  swapped into the middle at the end, so that afterwards
+     *      A[l..lt-1] < p,  A[lt..gt] == p,  A[gt+1..r] > p
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     *      lt (Index&) :   Set to the first index equal to the pivot
+     *      gt (Index&) :   Set to the last index equal to the pivot
+     */
+
+    const T p = A[l];
+
+    Index i = l;        // Scans right for values not less than p
+    Index j = r+1;      // Scans left for values not greater than p
+    Index el = l;       // A[l..el] == p
+    Index er = r+1;     // A[er..r] == p
+    while (true) {
+        do i++; while(i < r && comp(A[i], p));
+        do j--; while(comp(p, A[j]));       // A[l] == p stops j at l
+        if (i == j && !comp(A[i], p) && !comp(p, A[i])) {
+            // i and j met on a value equal to p
+            swap_values(A[++el], A[i]);
+        }
+        if (i >= j) {
+            break;
+        }
+        swap_values(A[i], A[j]);
+        if (!comp(A[i], p)) {
+            swap_values(A[++el], A[i]);       // A[i] == p, park it on the left
+        }
+        if (!comp(p, A[j])) {
+            swap_values(A[--er], A[j]);       // A[j] == p, park it on the right
+        }
+    }
+
+    // Swap the parked equal values into the middle
+    i = j+1;
+    for (Index k = l; k <= el; k++) {
+        swap_values(A[k], A[j--]);
+    }
+    for (Index k = r; k >= er; k--) {
+        swap_values(A[k], A[i++]);
+    }
+    lt = j+1;
+    gt = i-1;
+}
+
+template <typename T, typename Compare, typename Index>
+bool QuickSort<T, Compare, Index>::sort3(const Index a, const Index b, 
+    const Index c) {
+    /**
+     * Orders the values at the given indices so that A[a] <= A[b] <= A[c]
+     * 
+     * Returns:
+     *  (bool)  :   true if any two of the three values are equal
+     */
+    if (comp(A[b], A[a])) swap_values(A[a], A[b]);
+    if (comp(A[c], A[b])) swap_values(A[b], A[c]);
+    if (comp(A[b], A[a])) swap_values(A[a], A[b]);
+    return !comp(A[a], A[b]) || !comp(A[b], A[c]);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::insertion_sort(const Index l, const Index r) {
+    /**
+     * Hybrid engine - sorts the small subarray A[l..r] with insertion sort
+     */
+    for (Index i = l+1; i <= r; i++) {
+        T value = std::move(A[i]);
+        Index j = i;
+        while (j > l && comp(value, A[j-1])) {
+            A[j] = std::move(A[j-1]);
+            j--;
+        }
+        A[j] = std::move(value);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::heap_sort(const Index l, const Index r) {
+    /**
+     * Hybrid engine - sorts A[l..r] with heap sort
+     * Used when introsort exceeds its depth limit
+     */
+    Index n = r - l + 1;
+    for (Index root = n/2 - 1; root >= 0; root--) {
+        sift_down(l, root, n);
+    }
+    for (Index end = n-1; end > 0; end--) {
+        swap_values(A[l], A[l+end]);
+        sift_down(l, 0, end);
+    }
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::sift_down(const Index l, Index root, 
+    const Index n) {
+    /**
+     * Restores the max-heap property of the n element heap starting at A[l]
+     *  below the given root
+     */
+    T value = std::move(A[l+root]);
+    Index child;
+    while ((child = 2*root + 1) < n) {
+        if (child+1 < n && comp(A[l+child], A[l+child+1])) {
+            child++;
+        }
+        if (!comp(value, A[l+child])) {
+            break;
+        }
+        A[l+root] = std::move(A[l+child]);
+        root = child;
+    }
+    A[l+root] = std::move(value);
+}
+
+template <typename T, typename Compare, typename Index>
+Index QuickSort<T, Compare, Index>::generate_random_int(const Index lower, 
+    const Index upper) {
+    /**
+     * Generates a random integer in the range [lower, upper)
+     * 
+     * Parameters:
+     *  lower (Index) :   lower limit of random number to generate (inclusive)
+     *  upper (Index) :   upper limit of random number to generate (exclusive)
+     * 
+     * Returns:
+     *  (Index) :   Random integer within given range
+     */
+    
+    if (lower > upper) {
+        // Return lower limit and log error if range is invalid
+        std::cerr << "generate_random_int : invalid range" 
+            << " - returning lower limit" << std::endl;
+        return lower;
+    }
+    if (lower == upper) {
+        // Return lower limit if the range is 0
+        return lower;
+    }
+    // Return a random integer within given range, without modulo bias
+    Index range = upper - lower;
+    return static_cast<Index>(rng.bounded(range)) + lower;
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::swap(const Index i, const Index j) {
+    /**
+     * This function swaps the values at the given indices
+     * 
+     * Parameters:
+     *      i (Index)   :   first index to swap
+     *      j (Index)   :   second index to swap
+     */
+
+    if (static_cast<std::size_t>(i) >= A.size()) {
+        // If first index is out of range, do nothing
+        std::cerr << "swap(" << i << ", " << j << ") : index i is out of range "
+            << "- swap incomplete" << std::endl;
+        return;
+    }
+    if (static_cast<std::size_t>(j) >= A.size()) {
+        // If second index is out of range, do nothing
+        std::cerr << "swap(" << i << ", " << j << ") : index j is out of range "
+            << "- swap incomplete" << std::endl;
+        return;
+    }
+    if (i == j) {
+        // If indices are equal, do nothing
+        return;
+    }
+
+    // Swap values at given indices
+    swap_values(A[i], A[j]);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::swap_values(T &a, T &b) {
+    /**
+     * Swaps two values of "A", counting the swap in instrumented builds
+     * 
+     * Parameters:
+     *      a (T &)     :   first value
+     *      b (T &)     :   second value
+     */
+#ifdef QUICKSORT_INSTRUMENT
+    counters.swaps.fetch_add(1, std::memory_order_relaxed);
+#endif
+    std::swap(a, b);
+}
+
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::count_partition(const Index l, 
+    const Index r, const Index lt, const Index gt, const int depth) {
+    /**
+     * Counts a partition of A[l..r] in instrumented builds, and does 
+     *  nothing otherwise
+     * 
+     * Parameters:
+     *      l (Index)   :   Index to start subarray
+     *      r (Index)   :   Index to end subarray
+     *      lt (Index)  :   first index of values equal to the pivot
+     *      gt (Index)  :   last index of values equal to the pivot
+     *      depth (int) :   partition level of the subarray, from 1
+     */
+#ifdef QUICKSORT_INSTRUMENT
+    counters.record_partition(r - l + 1, std::max(lt - l, r - gt), depth);
+#endif
+}
+
+template <typename T, typename Compare, typename Index>
+template <typename I>
+std::vector<I> QuickSort<T, Compare, Index>::arg_sort() {
+    /**
+     * Returns the permutation that sorts "A" without moving "A"
+     * Packed (key, index) records are sorted with the selected engine, so 
+     *  every comparison reads its key from the record being moved instead
+     *  of following an index into "A"
+     * Records the time of the whole argsort
+     * 
+     * Template Parameters:
+     *  I   :   Unsigned index type (uint32_t or uint64_t)
+     * 
+     * Returns:
+     *      (vector<I>) :   indices of "A" in sorted order, empty if "A" has
+     *                      more values than I can index
+     */
+    static_assert(std::is_integral_v<I> && std::is_unsigned_v<I>,
+        "arg_sort indices must be an unsigned integer type");
+
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+    auto sort_start = std::chrono::steady_clock::now();
+    std::uint64_t sort_start_cycles = read_cycle_counter();
+
+    if (A.size() > static_cast<std::size_t>(std::numeric_limits<I>::max())) {
+        std::cerr << "Too many values for the index type" << std::endl;
+        end_cycles = start_cycles = sort_start_cycles;
+        end_time = start_time = sort_start;
+        timed_values = 0;
+        return std::vector<I>();
+    }
+
+    using R = Record<T, I>;
+    std::vector<R> records(A.size());
+    for (std::size_t i = 0; i < A.size(); i++) {
+        records[i] = {A[i], static_cast<I>(i)};
+    }
+    records = sort_records(std::move(records));
+    std::vector<I> indices(records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+        indices[i] = records[i].payload;
+    }
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();
+    start_cycles = sort_start_cycles;
+    start_time = sort_start;
+    timed_values = A.size();
+    return indices;
+}
+
+template <typename T, typename Compare, typename Index>
+template <typename P>
+int QuickSort<T, Compare, Index>::sort_with_payload(std::vector<P> &payload,
+    const PayloadSort method) {
+    /**
+     * Sorts "A" and applies the same permutation to a payload array
+     *  - packed  : keys and payloads are packed into records that are 
+     *              sorted together, then split again
+     *  - indices : the keys are argsorted, then both arrays are gathered
+     *              through the indices (one random access per value)
+     * Records the time of the whole sort
+     * 
+     * Parameters:
+     *      payload (vector<P> &)   :   one payload per value of "A"
+     *      method (PayloadSort)    :   packed or indices
+     * 
+     * Returns:
+     *      int :   Returns 1 if the arrays were sorted, 0 if their sizes 
+     *              differ
+     */
+
+    if (payload.size() != A.size()) {
+        std::cerr << "Payload and key arrays differ in size" << std::endl;
+        return 0;
+    }
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, sort_counters);
+#endif
+
+    auto sort_start = std::chrono::steady_clock::now();
+    std::uint64_t sort_start_cycles = read_cycle_counter();
+
+    if (method == PayloadSort::packed) {
+        using R = Record<T, P>;
+        std::vector<R> records(A.size());
+        for (std::size_t i = 0; i < A.size(); i++) {
+            records[i] = {A[i], std::move(payload[i])};
+        }
+        records = sort_records(std::move(records));
+        for (std::size_t i = 0; i < records.size(); i++) {
+            A[i] = records[i].key;
+            payload[i] = std::move(records[i].payload);
+        }
+    }
+    else {
+        auto gather = [&](const auto &indices) {
+            std::vector<T> keys(A.size());
+            std::vector<P> values(A.size());
+            for (std::size_t i = 0; i < indices.size(); i++) {
+                keys[i] = A[indices[i]];
+                values[i] = std::move(payload[indices[i]]);
+            }
+            A = std::move(keys);
+            payload = std::move(values);
+        };
+        // 32-bit indices halve the size of the records when they suffice
+        if (A.size() <= std::numeric_limits<std::uint32_t>::max()) {
+            gather(arg_sort<std::uint32_t>());
+        }
+        else {
+            gather(arg_sort<std::uint64_t>());
+        }
+    }
+
+    end_cycles = read_cycle_counter();
+    end_time = std::chrono::steady_clock::now();
+    start_cycles = sort_start_cycles;
+    start_time = sort_start;
+    timed_values = A.size();
+    return 1;
+}
+
+template <typename T, typename Compare, typename Index>
+template <typename R>
+std::vector<R> QuickSort<T, Compare, Index>::sort_records(
+    std::vector<R> records) const {
+    /**
+     * Sorts records by their key with the engine, instruction set and
+     *  thread pool of this sorter
      * 
      * Parameters:
-     *      filename (string)   :   name of file to read values from
+     *      records (vector<R>) :   records with a key of type T
      * 
      * Returns:
-     *      int :   Returns 1 if file reading was successful, 0 if not
+     *      (vector<R>) :   the records in sorted order
      */
+    QuickSort<R, KeyLess<R, Compare>, Index> sorter(KeyLess<R, Compare>{comp});
+    sorter.set_engine(engine);
+    sorter.set_simd_level(simd_level);
+    sorter.set_presort(presort);
+    sorter.set_arena(arena);
+    sorter.set_seed(seed);
+    sorter.set_thread_pool(pool);
+    sorter.set_array(std::move(records));
+    sorter.quick_sort();
+    return sorter.release_array();
+}
 
-    std::string line;                   // line of input file
-    double value;                       // each value read from file
-
-    A = std::vector<double>();          // Initialize new array
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::write_file(
+    const std::string &filename) const {
+    /**
+     * This function writes a vector to a file of a given name
+     * Arithmetic types are formatted with std::to_chars by write_formatted,
+     *  or written as a binary file if the output format is binary, other
+     *  types are written with operator<<
+     * Output file
+     *  - Outputs values of array seperated by whitespace
+     * 
+     * Parameters:
+     *      filename (string)   :   Name of file to write values to
+     */
 
-    // Open file
-    std::ifstream in_file(filename);    // Input file stream
-    if (!in_file) {
-        std::cerr << "Error Opening Input File" << std::endl;
-        return 0;   // return 0 to indicate failure
-    }
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, write_counters);
+#endif
 
-    // Get each line of input file 
-    while(std::getline(in_file, line)) { 
-        std::istringstream iss(line);   // Delim file line by whitespace
-        while (iss >> value) {
-            A.push_back(value);         // add each value to vector
+    if constexpr (binary_type_of<T>() != BinaryType::none) {
+        if (output_format == FileFormat::binary) {
+            return write_binary_file(filename, A.data(), A.size());
         }
     }
-    in_file.close();
+    else if (output_format == FileFormat::binary) {
+        std::cerr << "Type cannot be written as a binary file" << std::endl;
+        return 0;
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+        return write_formatted(filename);
+    }
 
-    // Check if file was empty or did not exist
-    if (A.size() == 0) {
-        std::cerr << "Input file is empty or does not exist - array not populated" << std::endl;
+    std::ofstream out_file(filename);
+    if (!out_file) {
+        std::cerr << "Error Opening Output File" << std::endl;
         return 0;   // return 0 to indicate failure
     }
+
+    // Write to file
+    for (auto val : A) {
+        out_file << val << " ";
+    }
+    out_file.close();
     
     return 1;
 }
 
-int QuickSort::quick_sort() {
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::write_formatted(
+    const std::string &filename) const {
     /**
-     * Implements the QuickSort algorithm using the Hoarse Partition 
-     *  Algorithm with random pivots
-     * Records start and end time of algorithm
-     * Algorithm is implemented in overloaded recursive function
+     * Writes "A" with the selected write mode
+     * Values are formatted with std::to_chars in their shortest round trip
+     *  form into reusable 1 MiB chunks, so no locale or stream is involved
+     *  and the file parses back to exactly the same values
      * 
-     * Returns:
-     *      (int)   :   returns 1 to indicate success
+     * Parameters:
+     *      filename (string)   :   Name of file to write values to
      * 
+     * Returns:
+     *      int :   Returns 1 if the file was written, 0 if not
      */
 
-    start_time = std::chrono::high_resolution_clock::now();     // Start timer
-
-    if (A.size() == 0 || A.size() == 1) {
-        // If array is empty or has only one element, do nothing
-        return 1;
+    int fd = -1;
+    WriteMode mode = write_mode;
+#ifdef O_DIRECT
+    if (mode == WriteMode::direct) {
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    }
+#endif
+    if (fd < 0) {
+        if (mode == WriteMode::direct) {
+            mode = WriteMode::buffered;     // O_DIRECT is not supported
+        }
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0) {
+        std::cerr << "Error Opening Output File" << std::endl;
+        return 0;   // return 0 to indicate failure
     }
 
-    // QuickSort starting with first and last indices
-    int ret = quick_sort(0, A.size()-1);
-
-    end_time = std::chrono::high_resolution_clock::now();       // Stop timer
+    int ret = 1;
+    std::size_t next = 0;       // Next value of "A" to format
+    if (mode == WriteMode::writev) {
+        // Format every chunk, then gather them in as few calls as possible
+        std::vector<struct iovec> iov;
+        for (std::size_t c = 0; next < A.size(); c++) {
+            if (c == write_chunks.size()) {
+                write_chunks.emplace_back(write_chunk_size);
+            }
+            std::size_t len = format_text_values(A.data(), A.size(), next, 
+                write_chunks[c].data(), write_chunk_size);
+            iov.push_back({write_chunks[c].data(), len});
+        }
+        for (std::size_t i = 0; i < iov.size() && ret; i += IOV_MAX) {
+            std::size_t count = std::min<std::size_t>(IOV_MAX, iov.size() - i);
+            std::size_t total = 0;
+            for (std::size_t k = i; k < i + count; k++) {
+                total += iov[k].iov_len;
+            }
+            ssize_t written = writev(fd, &iov[i], count);
+            if (written < 0 || static_cast<std::size_t>(written) != total) {
+                // Finish a short or failed gather one chunk at a time
+                std::size_t done = (written < 0) ? 0 : written;
+                for (std::size_t k = i; k < i + count && ret; k++) {
+                    const char *base = static_cast<const char *>(iov[k].iov_base);
+                    if (done >= iov[k].iov_len) {
+                        done -= iov[k].iov_len;
+                        continue;
+                    }
+                    ret = write_fully(fd, base + done, iov[k].iov_len - done);
+                    done = 0;
+                }
+            }
+        }
+    }
+    else if (mode == WriteMode::direct) {
+        // O_DIRECT needs aligned buffers and lengths - every chunk writes
+        //  its aligned part and carries the rest into the next one, so only
+        //  the last write is padded and the file is truncated to its real
+        //  size afterwards
+        void *mem = nullptr;
+        if (posix_memalign(&mem, direct_alignment, write_chunk_size) != 0) {
+            close(fd);
+            return 0;
+        }
+        char *buffer = static_cast<char *>(mem);
+        std::size_t total = 0;
+        std::size_t fill = 0;       // Bytes formatted but not written
+        while (next < A.size() && ret) {
+            std::size_t len = format_text_values(A.data(), A.size(), next, 
+                buffer + fill, write_chunk_size - fill);
+            total += len;
+            fill += len;
+            if (next < A.size()) {
+                std::size_t aligned = fill / direct_alignment 
+                    * direct_alignment;
+                ret = write_fully(fd, buffer, aligned);
+                std::memmove(buffer, buffer + aligned, fill - aligned);
+                fill -= aligned;
+            }
+        }
+        if (ret && fill > 0) {
+            std::size_t padded = (fill + direct_alignment - 1) 
+                / direct_alignment * direct_alignment;
+            std::fill(buffer + fill, buffer + padded, ' ');
+            ret = write_fully(fd, buffer, padded);
+        }
+        free(mem);
+        if (ret && ftruncate(fd, total) != 0) {
+            ret = 0;
+        }
+    }
+    else {
+        // One write call per formatted chunk
+        if (write_chunks.empty()) {
+            write_chunks.emplace_back(write_chunk_size);
+        }
+        char *buffer = write_chunks[0].data();
+        while (next < A.size() && ret) {
+            std::size_t len = format_text_values(A.data(), A.size(), next, 
+                buffer, write_chunk_size);
+            ret = write_fully(fd, buffer, len);
+        }
+    }
 
-    return ret;
+    if (close(fd) != 0 || !ret) {
+        std::cerr << "Error Writing Output File" << std::endl;
+        return 0;
+    }
+    return 1;
 }
 
-int QuickSort::quick_sort(const int l, const int r) {
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::format_output(std::vector<char> &out) const {
     /**
-     * Implements the QuickSort algorithm to sort "A"
+     * Formats "A" as the contents of its sorted file, ASCII or binary like
+     *  write_file, for a caller that writes the file itself (see AsyncIO.h)
      * 
      * Parameters:
-     *  A (vector<double>)  :   subarray to sort
-     *  l (size_t) :   Index to start subarray
-     *  r (size_t) :   Index to stop subarray
+     *      out (vector<char> &)    :   set to the file contents, its 
+     *                                  capacity is reused
      * 
      * Returns:
-     *  (int)   : returns 1 to indicate success
+     *      int :   Returns 1 if "A" was formatted, 0 if not
      */
+    static_assert(std::is_arithmetic_v<T>,
+        "format_output formats arithmetic types only");
 
-    int s = 0;      // Partition index
-    // Continue until indices overlap
-    if (l < r) {
-        // Parition array and get index to split
-        s = hoarse_partition(l, r);
-        quick_sort(l, s-1);         // Sort left partition
-        quick_sort(s+1, r);         // Sort right partition
+#ifdef QUICKSORT_INSTRUMENT
+    CounterScope scope(counters, write_counters);
+#endif
+
+    if (output_format == FileFormat::binary) {
+        if constexpr (binary_type_of<T>() != BinaryType::none) {
+            encode_binary_file(A.data(), A.size(), out);
+            return 1;
+        }
+        std::cerr << "Type cannot be written as a binary file" << std::endl;
+        return 0;
+    }
+
+    // Grow by a chunk at most, so small files do not clear a whole chunk
+    std::size_t len = 0;
+    std::size_t next = 0;       // Next value of "A" to format
+    while (next < A.size()) {
+        std::size_t room = std::min(write_chunk_size, 
+            (A.size() - next + 1) * text_value_max_length + 1);
+        out.resize(len + room);
+        len += format_text_values(A.data(), A.size(), next, 
+            out.data() + len, room);
     }
+    out.resize(len);
     return 1;
 }
 
-int QuickSort::hoarse_partition(const int l, const int r) {
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::external_sort_file(const std::string in_path, 
+    const std::string out_path, const std::size_t memory_budget) {
     /**
-     * Implements a hoarse partition on a provided subarray
+     * Sorts a file that may not fit in memory with an external merge sort
+     *  1. The input (ASCII or binary) is streamed in blocks into a chunk of
+     *     the memory budget
+     *  2. Every full chunk is sorted with the selected engine and written to
+     *     a run file of raw values (out_path.runN)
+     *  3. The runs are merged with a loser tree into out_path
+     * Files that fit in one chunk are sorted in memory without run files
+     * Records the time of all three stages
      * 
      * Parameters:
-     *      l (size_t)  :   Index to start subarray
-     *      r (size_t)  :   Index to end subarray
+     *      in_path (string)        :   file to sort
+     *      out_path (string)       :   sorted file to write
+     *      memory_budget (size_t)  :   bytes for the input block and chunk
      * 
      * Returns:
-     *  (size_t)   :   Index that split occurs
+     *      int :   Returns 1 if the file was sorted, 0 if not
      */
 
-    // Generate random pivot and move the value to beginning of subarray
-    swap(l, generate_random_int(l, r+1));
-    int p = A[l]; 
-    
-    int i = l;    // Start i at left index after pivot
-    int j = r+1;      // Start j at right index
-
-    // Repeat iteration until i and j overlap
-    while (i < j) {
-        do i++; while(A[i] < p && i < r);    // Increment i until a value greater than p is reached
-        do j--; while(A[j] > p && j > l);      // Decrement j until a value less than p is reached
-        swap(i, j);
+    if constexpr (!std::is_arithmetic_v<T>) {
+        std::cerr << "External sort needs an arithmetic key type" << std::endl;
+        return 0;
     }
-    swap(i, j);          // Undo last swap when i >= j
-    swap(l, j);          // Swap pivot with j, the new partition
+    else {
+#ifdef QUICKSORT_INSTRUMENT
+        CounterScope scope(counters, sort_counters);
+#endif
+        auto sort_start = std::chrono::steady_clock::now();
+        std::uint64_t sort_start_cycles = read_cycle_counter();
 
-    return j;           // Return the partition index
+        int fd = open(in_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error Opening Input File" << std::endl;
+            return 0;   // return 0 to indicate failure
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            std::cerr << "Error Opening Input File" << std::endl;
+            return 0;   // return 0 to indicate failure
+        }
+
+        // Split the budget between the input block and the chunk
+        std::size_t block_size = std::max<std::size_t>(4096, 
+            std::min(external_block_size, memory_budget / 8) / 8 * 8);
+        block_size = std::min<std::size_t>(block_size, 
+            (st.st_size / 8 + 1) * 8);      // more than the whole file
+        std::size_t chunk_bytes = (memory_budget > block_size) 
+            ? memory_budget - block_size : 0;
+        if (engine == Engine::parallel || engine == Engine::radix
+            || engine == Engine::merge || engine == Engine::auto_select) {
+            chunk_bytes /= 2;       // room for the partition or radix buffer
+        }
+        const std::size_t chunk_values = 
+            std::max<std::size_t>(chunk_bytes / sizeof(T), 1);
+
+        std::vector<char> block(block_size);
+        // Every value takes at least 2 bytes, so small files reserve less
+        A = std::vector<T>();
+        A.reserve(std::min<std::size_t>(chunk_values, st.st_size / 2 + 1));
+        std::vector<std::string> runs;
+        std::uint64_t total = 0;
+        int ret = 1;
+
+        // Sort the full chunk and write it as the next run
+        auto spill = [&]() {
+            quick_sort();
+            runs.push_back(out_path + ".run" + std::to_string(runs.size()));
+            total += A.size();
+            ret = write_run(runs.back());
+            A.clear();
+        };
+
+        ssize_t got = read_fully(fd, block.data(), block_size);
+        std::size_t have = (got < 0) ? 0 : got;
+        ret = (got >= 0);
+        if (ret && is_binary_file(block.data(), have)) {
+            // Binary input: decode the payload block by block. Blocks are
+            //  multiples of 8 bytes so the checksum can be computed in pieces
+            //  and no value is split between two blocks
+            BinaryHeader header;
+            ret = have >= binary_header_size 
+                && decode_binary_header(block.data(), st.st_size, header);
+            std::uint64_t checksum = binary_checksum_basis;
+            std::size_t pos = binary_header_size;
+            while (ret && pos < have) {
+                checksum = binary_checksum(block.data() + pos, have - pos, 
+                    checksum);
+                while (ret && pos < have) {
+                    BinaryHeader piece = header;
+                    piece.count = std::min<std::size_t>(
+                        (have - pos) / header.element_size, 
+                        chunk_values - A.size());
+                    std::size_t old_size = A.size();
+                    A.resize(old_size + piece.count);
+                    decode_binary_values(block.data() + pos, piece, 
+                        A.data() + old_size);
+                    pos += piece.count * header.element_size;
+                    if (A.size() == chunk_values) {
+                        spill();
+                    }
+                }
+                if (have < block_size) {
+                    break;      // end of file
+                }
+                got = read_fully(fd, block.data(), block_size);
+                ret = ret && (got >= 0);
+                have = (got < 0) ? 0 : got;
+                pos = 0;
+            }
+            if (ret && checksum != header.checksum) {
+                std::cerr << "Binary input file checksum mismatch" << std::endl;
+                ret = 0;
+            }
+        }
+        else if (ret) {
+            ret = parse_text_stream(fd, block, have, have < block_size, 
+                chunk_values, [&]() { spill(); return ret; });
+        }
+        close(fd);
+        block = std::vector<char>();
+
+        if (!ret) {
+            std::cerr << "Error Reading Input File" << std::endl;
+        }
+        else if (runs.empty()) {
+            // The whole file fit in one chunk
+            quick_sort();
+            total = A.size();
+            ret = write_file(out_path);
+        }
+        else {
+            if (!A.empty()) {
+                spill();
+            }
+            A = std::vector<T>();   // Hand the chunk memory to the merge
+            ret = ret && merge_runs(runs, out_path, memory_budget);
+        }
+        for (const auto &run : runs) {
+            unlink(run.c_str());
+        }
+
+        end_cycles = read_cycle_counter();
+        end_time = std::chrono::steady_clock::now();
+        start_cycles = sort_start_cycles;
+        start_time = sort_start;
+        timed_values = total;
+        return ret;
+    }
 }
 
-int QuickSort::generate_random_int(const int lower, const int upper) {
+template <typename T, typename Compare, typename Index>
+template <typename OnFull>
+int QuickSort<T, Compare, Index>::parse_text_stream(const int fd, 
+    std::vector<char> &block, std::size_t have, bool eof, 
+    const std::size_t chunk_values, OnFull on_full) {
     /**
-     * Generates a random integer in the range [lower, upper)
+     * Parses whitespace separated values from a file descriptor into "A",
+     *  one block at a time. The complete values of each block are parsed and
+     *  the last, possibly cut, value is carried over to the next block
+     * Blocks are parsed as soon as read returns, so values that arrive
+     *  slowly through a pipe are parsed while the writer is still running
      * 
      * Parameters:
-     *  lower (int) :   lower limit of random number to generate (inclusive)
-     *  upper (int) :   upper limit of random number to generate (exclusive)
+     *      fd (int)                :   file descriptor to read
+     *      block (vector<char> &)  :   read buffer
+     *      have (size_t)           :   bytes already read into block
+     *      eof (bool)              :   true if those bytes end the input
+     *      chunk_values (size_t)   :   on_full is called whenever "A" holds
+     *                                  this many values
+     *      on_full (OnFull)        :   empties "A", returns 0 to stop
      * 
      * Returns:
-     *  (int)   :   Random integer within given range
+     *      int :   Returns 1 if all input was parsed, 0 if not
      */
-    
-    if (lower > upper) {
-        // Return lower limit and log error if range is invalid
-        std::cerr << "generate_random_int : invalid range" 
-            << " - returning lower limit" << std::endl;
-        return lower;
-    }
-    if (lower == upper) {
-        // Return lower limit if the range is 0
-        return lower;
+    while (true) {
+        const char *first = block.data();
+        const char *last = first + have;
+        const char *end = last;
+        if (!eof) {
+            while (end > first 
+                && !std::isspace(static_cast<unsigned char>(end[-1]))) {
+                end--;
+            }
+            if (end == first && have == block.size()) {
+                end = last;     // a full block without whitespace
+            }
+        }
+        const char *p = first;
+        while (p < end) {
+            p = parse_buffer(p, end, chunk_values - A.size());
+            if (A.size() == chunk_values && !on_full()) {
+                return 0;
+            }
+        }
+        if (eof) {
+            return 1;
+        }
+        std::size_t rest = last - end;
+        std::memmove(block.data(), end, rest);
+        ssize_t got;
+        do {
+            got = read(fd, block.data() + rest, block.size() - rest);
+        } while (got < 0 && errno == EINTR);
+        if (got < 0) {
+            return 0;
+        }
+        have = rest + got;
+        eof = (got == 0);
     }
-    // Return a random integer within given range
-    int range = upper - lower;
-    return std::floor(std::rand() % range + lower);
 }
 
-void QuickSort::swap(const int i, const int j) {
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::stream_sort(const int in_fd, 
+    const int out_fd, StreamStats &stats) {
     /**
-     * This function swaps the values at the given indices
+     * Sorts the values read from one file descriptor into another
+     *  1. Values are parsed as they arrive and collected into runs of
+     *     stream_run_size values. Every full run is sorted right away, while
+     *     the rest of the input is still being read
+     *  2. When the input ends, only the last partial run is left to sort
+     *  3. The sorted runs are merged with a loser tree straight into the 
+     *     output, so the first values are written after one merge block
+     * Runs are kept in memory and freed as the merge drains them
      * 
      * Parameters:
-     *      i (int) :   first index to swap
-     *      j (int) :   second index to swap
+     *      in_fd (int)             :   file descriptor to read values from
+     *      out_fd (int)            :   file descriptor to write values to
+     *      stats (StreamStats &)   :   set to the size and timings of the sort
+     * 
+     * Returns:
+     *      int :   Returns 1 if the values were sorted and written, 0 if not
      */
 
-    if (i >= A.size()) {
-        // If first index is out of range, do nothing
-        std::cerr << "swap(" << i << ", " << j << ") : index i is out of range "
-            << "- swap incomplete" << std::endl;
-        return;
-    }
-    if (j >= A.size()) {
-        // If second index is out of range, do nothing
-        std::cerr << "swap(" << i << ", " << j << ") : index j is out of range "
-            << "- swap incomplete" << std::endl;
-        return;
+    if constexpr (!std::is_arithmetic_v<T>) {
+        std::cerr << "Streaming needs an arithmetic key type" << std::endl;
+        return 0;
     }
-    if (i == j) {
-        // If indices are equal, do nothing
-        return;
+    else {
+        using Clock = std::chrono::steady_clock;
+        auto elapsed = [](Clock::time_point from) {
+            return std::chrono::duration<double, std::milli>(
+                Clock::now() - from).count();
+        };
+        auto stream_start = Clock::now();
+
+        std::vector<std::vector<T>> runs;
+        std::vector<char> block(stream_block_size);
+        A = std::vector<T>();
+        A.reserve(stream_run_size);
+        if (write_chunks.empty()) {
+            // Allocate the output buffer before the input ends
+            write_chunks.emplace_back(write_chunk_size);
+        }
+
+        auto close_run = [&]() {
+            quick_sort();
+            if (A.empty()) {
+                return 1;           // every value was a dropped NaN
+            }
+            runs.push_back(std::move(A));
+            A = std::vector<T>();
+            A.reserve(stream_run_size);
+            return 1;
+        };
+        if (!parse_text_stream(in_fd, block, 0, false, stream_run_size, 
+            close_run)) {
+            std::cerr << "Error Reading Input" << std::endl;
+            return 0;
+        }
+        if (!A.empty()) {
+            quick_sort();
+        }
+        if (!A.empty()) {
+            runs.push_back(std::move(A));
+        }
+        A = std::vector<T>();
+        auto input_end = Clock::now();
+
+        stats.values = 0;
+        for (const auto &run : runs) {
+            stats.values += run.size();
+        }
+        stats.runs = runs.size();
+        stats.first_output = -1;
+
+        // Merge the runs into the output
+        char *buffer = write_chunks[0].data();
+        int ret = 1;
+        std::vector<T> out;
+        out.reserve(stream_run_size);
+        auto flush = [&]() {
+            std::size_t next = 0;
+            while (next < out.size() && ret) {
+                std::size_t len = format_text_values(out.data(), out.size(),
+                    next, buffer, write_chunk_size);
+                ret = write_fully(out_fd, buffer, len);
+                if (stats.first_output < 0) {
+                    stats.first_output = elapsed(stream_start);
+                    stats.after_input = elapsed(input_end);
+                }
+            }
+            out.clear();
+        };
+
+        LoserTree<T, TotalOrderLess<T, Compare>> tree(runs.size(), 
+            merge_order());
+        std::vector<std::size_t> pos(runs.size(), 1);
+        for (std::size_t i = 0; i < runs.size(); i++) {
+            tree.set(i, runs[i][0]);
+        }
+        tree.init();
+        while (!tree.empty() && ret) {
+            out.push_back(tree.top_key());
+            std::size_t r = tree.top();
+            if (pos[r] < runs[r].size()) {
+                tree.replace_top(runs[r][pos[r]++]);
+            }
+            else {
+                tree.finish_top();
+                runs[r] = std::vector<T>();     // Free the drained run
+            }
+            if (out.size() == stream_run_size) {
+                flush();
+            }
+        }
+        flush();
+
+        stats.total = elapsed(stream_start);
+        if (stats.first_output < 0) {
+            stats.first_output = stats.total;   // Nothing was written
+            stats.after_input = elapsed(input_end);
+        }
+        if (!ret) {
+            std::cerr << "Error Writing Output" << std::endl;
+        }
+        return ret;
     }
+}
 
-    // Swap values at given indices
-    double tmp = A[i];
-    A[i] = A[j];
-    A[j] = tmp;
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::write_run(const std::string path) const {
+    /**
+     * Writes "A" as raw values to a run file of the external sort
+     * 
+     * Parameters:
+     *      path (string)   :   run file to write
+     * 
+     * Returns:
+     *      int :   Returns 1 if the run was written, 0 if not
+     */
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        std::cerr << "Error Opening Run File" << std::endl;
+        return 0;
+    }
+    int ret = write_fully(fd, reinterpret_cast<const char *>(A.data()), 
+        A.size() * sizeof(T));
+    if (close(fd) != 0 || !ret) {
+        std::cerr << "Error Writing Run File" << std::endl;
+        return 0;
+    }
+    return 1;
 }
 
-int QuickSort::write_file(const std::string filename) const {
+template <typename T, typename Compare, typename Index>
+int QuickSort<T, Compare, Index>::merge_runs(
+    const std::vector<std::string> &runs, const std::string out_path, 
+    const std::size_t memory_budget) {
     /**
-     * This function writes a vector to a file of a given name
-     * Output file
-     *  - Outputs values of array seperated by whitespace
+     * Merges sorted run files into the sorted output file with a loser tree
+     * The budget is split evenly between one read buffer per run and the 
+     *  output buffer, but no buffer is smaller than external_min_buffer
      * 
      * Parameters:
-     *      filename (string)   :   Name of file to write values to
+     *      runs (vector<string>)   :   run files to merge
+     *      out_path (string)       :   sorted file to write
+     *      memory_budget (size_t)  :   bytes for all merge buffers
+     * 
+     * Returns:
+     *      int :   Returns 1 if the runs were merged, 0 if not
      */
 
-    std::ofstream out_file(filename);
-    if (!out_file) {
-        std::cerr << "Error Opening Output File" << std::endl;
-        return 0;   // return 0 to indicate failure
+    const std::size_t buffer_values = std::max(
+        memory_budget / (runs.size() + 1), external_min_buffer) / sizeof(T);
+
+    std::vector<std::unique_ptr<RunReader<T>>> readers;
+    LoserTree<T, TotalOrderLess<T, Compare>> tree(runs.size(), 
+        merge_order());
+    for (std::size_t i = 0; i < runs.size(); i++) {
+        readers.push_back(
+            std::make_unique<RunReader<T>>(runs[i], buffer_values));
+        T value;
+        if (readers[i]->next(value)) {
+            tree.set(i, value);
+        }
+        else {
+            tree.finish(i);
+        }
     }
+    tree.init();
 
-    // Write to file
-    for (auto val : A) {
-        out_file << val << " ";
+    // Open output
+    std::unique_ptr<BinaryWriter<T>> binary_out;
+    int fd = -1;
+    if constexpr (binary_type_of<T>() != BinaryType::none) {
+        if (output_format == FileFormat::binary) {
+            binary_out = std::make_unique<BinaryWriter<T>>(out_path, 
+                buffer_values * sizeof(T));
+        }
+    }
+    if (!binary_out) {
+        if (output_format == FileFormat::binary) {
+            std::cerr << "Type cannot be written as a binary file" << std::endl;
+            return 0;
+        }
+        fd = open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error Opening Output File" << std::endl;
+            return 0;
+        }
+        if (write_chunks.empty()) {
+            write_chunks.emplace_back(write_chunk_size);
+        }
+    }
+
+    int ret = 1;
+    std::vector<T> out;
+    out.reserve(buffer_values);
+    auto flush = [&]() {
+        if (binary_out) {
+            binary_out->append(out.data(), out.size());
+        }
+        else {
+            std::size_t next = 0;
+            while (next < out.size() && ret) {
+                std::size_t len = format_text_values(out.data(), out.size(),
+                    next, write_chunks[0].data(), write_chunk_size);
+                ret = write_fully(fd, write_chunks[0].data(), len);
+            }
+        }
+        out.clear();
+    };
+
+    while (!tree.empty() && ret) {
+        out.push_back(tree.top_key());
+        T value;
+        if (readers[tree.top()]->next(value)) {
+            tree.replace_top(value);
+        }
+        else {
+            tree.finish_top();
+        }
+        if (out.size() == buffer_values) {
+            flush();
+        }
+    }
+    flush();
+
+    for (const auto &reader : readers) {
+        if (!reader->ok()) {
+            std::cerr << "Error Reading Run File" << std::endl;
+            ret = 0;
+        }
+    }
+    if (binary_out) {
+        return binary_out->finish() && ret;
+    }
+    if (close(fd) != 0 || !ret) {
+        std::cerr << "Error Writing Output File" << std::endl;
+        return 0;
     }
-    out_file.close();
-    
     return 1;
 }
 
-double QuickSort::get_exe_time() const{
+template <typename T, typename Compare, typename Index>
+double QuickSort<T, Compare, Index>::get_exe_time() const{
     /**
      * This function calculates and returns the execution time in milliseconds
      *      of the most recent quick sort algorithm that was run
@@ -557,10 +4963,74 @@ double QuickSort::get_exe_time() const{
      *      (double)    :   execution time in milliseconds
      */
 
-    return (end_time - start_time).count()/1000.0;
+    return std::chrono::duration<double, std::milli>(
+        end_time - start_time).count();
+}
+
+template <typename T, typename Compare, typename Index>
+double QuickSort<T, Compare, Index>::get_cycles_per_element() const{
+    /**
+     * This function returns the number of cycle counter ticks per value taken
+     *      by the most recent quick sort algorithm that was run
+     * 
+     * Returns:
+     *      (double)    :   cycles per element
+     */
+
+    if (timed_values == 0) {
+        return 0;
+    }
+    return static_cast<double>(end_cycles - start_cycles) / timed_values;
+}
+
+template <typename T, typename Compare, typename Index>
+double QuickSort<T, Compare, Index>::get_parse_time() const {
+    /**
+     * Returns:
+     *      (double)    :   time in milliseconds spent parsing the last file
+     */
+    return parse_time;
+}
+
+template <typename T, typename Compare, typename Index>
+std::size_t QuickSort<T, Compare, Index>::get_parse_bytes() const {
+    /**
+     * Returns:
+     *      (size_t)    :   size in bytes of the last file that was read
+     */
+    return parse_bytes;
+}
+
+template <typename T, typename Compare, typename Index>
+const PhaseCounters &QuickSort<T, Compare, Index>::get_sort_counters() const {
+    /**
+     * Returns:
+     *      (PhaseCounters) :   counters of the last timed sort, all 0 unless
+     *                          built with QUICKSORT_INSTRUMENT
+     */
+    return sort_counters;
+}
+
+template <typename T, typename Compare, typename Index>
+const PhaseCounters &QuickSort<T, Compare, Index>::get_read_counters() const {
+    /**
+     * Returns:
+     *      (PhaseCounters) :   counters of the last read_file
+     */
+    return read_counters;
+}
+
+template <typename T, typename Compare, typename Index>
+const PhaseCounters &QuickSort<T, Compare, Index>::get_write_counters() const {
+    /**
+     * Returns:
+     *      (PhaseCounters) :   counters of the last write_file
+     */
+    return write_counters;
 }
 
-void QuickSort::print_array() const {
+template <typename T, typename Compare, typename Index>
+void QuickSort<T, Compare, Index>::print_array() const {
     /**
      * Prints "A" to stdout
      */
@@ -0,0 +1,603 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     BinaryFormat.h
+ *
+ * This header implements the binary input/output format shared by
+ *   InputFileGenerator.cpp, Azeem_Musa_QuickSort.cpp and FormatConverter.cpp
+ *  - A binary file is a 32 byte header followed by the raw values
+ *  - The payload can be used straight from a memory map, no parsing needed
+ *
+ * Header Layout (all fields little endian):
+ *  - bytes  0-7    :   magic "QSORTBIN"
+ *  - bytes  8-9    :   format version (1)
+ *  - byte   10     :   element type (1 = double, 2 = float, 3 = int64,
+ *                      4 = uint32)
+ *  - byte   11     :   payload byte order (1 = little endian)
+ *  - bytes 12-15   :   size of one element in bytes
+ *  - bytes 16-23   :   number of elements
+ *  - bytes 24-31   :   checksum of the payload (FNV-1a over 64-bit words,
+ *                      the trailing bytes are folded in one at a time)
+ */
+
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Format of input and output files
+enum class FileFormat { ascii, binary };
+
+// Element type codes stored in the header
+enum class BinaryType : std::uint8_t {
+    none = 0, float64 = 1, float32 = 2, int64 = 3, uint32 = 4
+};
+
+struct BinaryHeader {
+    BinaryType type;
+    std::uint32_t element_size;
+    std::uint64_t count;
+    std::uint64_t checksum;
+};
+
+constexpr char binary_magic[8] = {'Q', 'S', 'O', 'R', 'T', 'B', 'I', 'N'};
+constexpr std::uint16_t binary_version = 1;
+constexpr std::uint8_t binary_little_endian = 1;
+constexpr std::size_t binary_header_size = 32;
+constexpr std::uint64_t binary_checksum_basis = 0xcbf29ce484222325ULL;
+
+template <typename T>
+constexpr BinaryType binary_type_of() {
+    /**
+     * Returns:
+     *      BinaryType  :   type code of T, none if T cannot be stored
+     */
+    if constexpr (std::is_same_v<T, double>) {
+        return BinaryType::float64;
+    }
+    else if constexpr (std::is_same_v<T, float>) {
+        return BinaryType::float32;
+    }
+    else if constexpr (std::is_same_v<T, std::int64_t>) {
+        return BinaryType::int64;
+    }
+    else if constexpr (std::is_same_v<T, std::uint32_t>) {
+        return BinaryType::uint32;
+    }
+    else {
+        return BinaryType::none;
+    }
+}
+
+inline std::size_t binary_type_size(const BinaryType type) {
+    /**
+     * Returns:
+     *      size_t  :   size of one element of the given type, 0 for none
+     */
+    switch (type) {
+        case BinaryType::float64:   return sizeof(double);
+        case BinaryType::float32:   return sizeof(float);
+        case BinaryType::int64:     return sizeof(std::int64_t);
+        case BinaryType::uint32:    return sizeof(std::uint32_t);
+        default:                    return 0;
+    }
+}
+
+inline constexpr bool host_is_little_endian() {
+    /**
+     * Returns:
+     *      bool    :   true if the payload can be copied without swapping
+     */
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+template <typename U>
+U byte_swap(const U value) {
+    /**
+     * Reverses the bytes of an unsigned integer of 4 or 8 bytes
+     */
+    if constexpr (sizeof(U) == 8) {
+        return __builtin_bswap64(value);
+    }
+    else if constexpr (sizeof(U) == 4) {
+        return __builtin_bswap32(value);
+    }
+    else {
+        return __builtin_bswap16(value);
+    }
+}
+
+template <typename U>
+U load_le(const char *p) {
+    /**
+     * Reads an unsigned integer stored little endian at p
+     */
+    U value;
+    std::memcpy(&value, p, sizeof(U));
+    return host_is_little_endian() ? value : byte_swap(value);
+}
+
+template <typename U>
+void store_le(char *p, const U value) {
+    /**
+     * Writes an unsigned integer little endian to p
+     */
+    U le = host_is_little_endian() ? value : byte_swap(value);
+    std::memcpy(p, &le, sizeof(U));
+}
+
+inline std::uint64_t binary_checksum(const char *data, const std::size_t size,
+    std::uint64_t hash = binary_checksum_basis) {
+    /**
+     * Hashes a payload with FNV-1a over little endian 64-bit words
+     * Hashing words instead of bytes keeps the checksum far cheaper than
+     *  reading the file
+     * A payload can be hashed in pieces by passing the previous result as
+     *  hash, as long as every piece but the last is a multiple of 8 bytes
+     *
+     * Parameters:
+     *      data (const char *) :   payload bytes
+     *      size (size_t)       :   number of bytes
+     *      hash (uint64_t)     :   checksum of the preceding pieces
+     *
+     * Returns:
+     *      uint64_t    :   checksum stored in the header
+     */
+    constexpr std::uint64_t prime = 0x100000001b3ULL;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        hash = (hash ^ load_le<std::uint64_t>(data + i)) * prime;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+    }
+    return hash;
+}
+
+inline bool is_binary_file(const char *data, const std::size_t size) {
+    /**
+     * Returns:
+     *      bool    :   true if the buffer starts with the binary magic
+     */
+    return size >= sizeof(binary_magic)
+        && std::memcmp(data, binary_magic, sizeof(binary_magic)) == 0;
+}
+
+inline int decode_binary_header(const char *data, const std::size_t size,
+    BinaryHeader &header) {
+    /**
+     * Reads and validates the header of a binary file
+     * The checksum is not verified here, see binary_checksum
+     *
+     * Parameters:
+     *      data (const char *)     :   start of the file
+     *      size (size_t)           :   size of the file
+     *      header (BinaryHeader &) :   set to the decoded header
+     *
+     * Returns:
+     *      int :   1 if the header is valid and matches the file size, 0 if not
+     */
+    if (size < binary_header_size || !is_binary_file(data, size)) {
+        std::cerr << "Not a binary input file" << std::endl;
+        return 0;
+    }
+    if (load_le<std::uint16_t>(data + 8) != binary_version) {
+        std::cerr << "Unsupported binary format version" << std::endl;
+        return 0;
+    }
+    if (static_cast<std::uint8_t>(data[11]) != binary_little_endian) {
+        std::cerr << "Unsupported binary byte order" << std::endl;
+        return 0;
+    }
+    header.type = static_cast<BinaryType>(data[10]);
+    header.element_size = load_le<std::uint32_t>(data + 12);
+    header.count = load_le<std::uint64_t>(data + 16);
+    header.checksum = load_le<std::uint64_t>(data + 24);
+    if (binary_type_size(header.type) == 0
+        || header.element_size != binary_type_size(header.type)) {
+        std::cerr << "Unknown binary element type" << std::endl;
+        return 0;
+    }
+    if ((size - binary_header_size) / header.element_size != header.count
+        || (size - binary_header_size) % header.element_size != 0) {
+        std::cerr << "Binary file size does not match its header" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+inline void encode_binary_header(char *data, const BinaryType type,
+    const std::uint64_t count, const std::uint64_t checksum) {
+    /**
+     * Writes a header for count values of the given type
+     *
+     * Parameters:
+     *      data (char *)       :   binary_header_size bytes to write to
+     *      type (BinaryType)   :   element type of the payload
+     *      count (uint64_t)    :   number of elements
+     *      checksum (uint64_t) :   checksum of the payload
+     */
+    std::memcpy(data, binary_magic, sizeof(binary_magic));
+    store_le<std::uint16_t>(data + 8, binary_version);
+    data[10] = static_cast<char>(type);
+    data[11] = static_cast<char>(binary_little_endian);
+    store_le<std::uint32_t>(data + 12,
+        static_cast<std::uint32_t>(binary_type_size(type)));
+    store_le<std::uint64_t>(data + 16, count);
+    store_le<std::uint64_t>(data + 24, checksum);
+}
+
+template <typename T, typename S>
+T convert_value(const S value) {
+    /**
+     * Converts a stored value to T. Values that an integer T cannot hold
+     *  are clamped to the range of T instead of being cast, which is
+     *  undefined for floating point values and wraps integers around to
+     *  values that were never stored. NaNs become 0
+     *
+     * Parameters:
+     *      value (S)   :   stored value
+     *
+     * Returns:
+     *      T   :   the value as T
+     */
+    if constexpr (std::is_floating_point_v<S> && std::is_integral_v<T>) {
+        if (value != value) {
+            return T(0);
+        }
+        if (value <= static_cast<S>(std::numeric_limits<T>::lowest())) {
+            return std::numeric_limits<T>::lowest();
+        }
+        if (value >= static_cast<S>(std::numeric_limits<T>::max())) {
+            return std::numeric_limits<T>::max();
+        }
+    }
+    else if constexpr (std::is_integral_v<S> && std::is_integral_v<T>) {
+        // Compared as intmax_t or uintmax_t, whichever holds both sides
+        if constexpr (std::is_signed_v<S>) {
+            if (value < 0) {
+                if constexpr (std::is_unsigned_v<T>) {
+                    return T(0);
+                }
+                else if (static_cast<std::intmax_t>(value)
+                    < static_cast<std::intmax_t>(
+                        std::numeric_limits<T>::lowest())) {
+                    return std::numeric_limits<T>::lowest();
+                }
+                return static_cast<T>(value);
+            }
+        }
+        if (static_cast<std::uintmax_t>(value)
+            > static_cast<std::uintmax_t>(std::numeric_limits<T>::max())) {
+            return std::numeric_limits<T>::max();
+        }
+    }
+    return static_cast<T>(value);
+}
+
+template <typename S, typename T>
+void decode_values_as(const char *payload, const std::uint64_t count, T *out) {
+    /**
+     * Converts count little endian values of type S to T
+     */
+    if constexpr (std::is_same_v<S, T>) {
+        if (host_is_little_endian()) {
+            std::memcpy(out, payload, count * sizeof(T));
+            return;
+        }
+    }
+    using Bits = std::conditional_t<sizeof(S) == 8, std::uint64_t,
+        std::uint32_t>;
+    for (std::uint64_t i = 0; i < count; i++) {
+        Bits bits = load_le<Bits>(payload + i * sizeof(S));
+        S value;
+        std::memcpy(&value, &bits, sizeof(S));
+        out[i] = convert_value<T>(value);
+    }
+}
+
+template <typename T>
+void decode_binary_values(const char *payload, const BinaryHeader &header,
+    T *out) {
+    /**
+     * Copies the payload into out, converting it to T if the file stores
+     *  another element type (see convert_value)
+     *
+     * Parameters:
+     *      payload (const char *)      :   values following the header
+     *      header (const BinaryHeader&):   decoded header of the file
+     *      out (T *)                   :   room for header.count values
+     */
+    switch (header.type) {
+        case BinaryType::float64:
+            decode_values_as<double>(payload, header.count, out);
+            break;
+        case BinaryType::float32:
+            decode_values_as<float>(payload, header.count, out);
+            break;
+        case BinaryType::int64:
+            decode_values_as<std::int64_t>(payload, header.count, out);
+            break;
+        case BinaryType::uint32:
+            decode_values_as<std::uint32_t>(payload, header.count, out);
+            break;
+        default:
+            break;
+    }
+}
+
+inline int write_fully(const int fd, const char *data, std::size_t size) {
+    /**
+     * Writes size bytes to a file descriptor, retrying short writes
+     *
+     * Returns:
+     *      int :   returns 1 for success, 0 if a write failed
+     */
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        data += written;
+        size -= written;
+    }
+    return 1;
+}
+
+inline ssize_t read_fully(const int fd, char *data, const std::size_t size) {
+    /**
+     * Reads up to size bytes from a file descriptor, retrying short reads
+     *
+     * Returns:
+     *      ssize_t :   bytes read (less than size only at the end of the
+     *                  file), -1 if a read failed
+     */
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t bytes = read(fd, data + done, size - done);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        done += bytes;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+template <typename T>
+int write_binary_file(const std::string &filename, const T *values,
+    const std::size_t count) {
+    /**
+     * Writes values to a binary file: the header and the payload are written
+     *  with one writev call, straight from "values" on little endian hosts
+     *
+     * Parameters:
+     *      filename (string)   :   file to write
+     *      values (const T *)  :   values to store
+     *      count (size_t)      :   number of values
+     *
+     * Returns:
+     *      int :   1 if the file was written, 0 if not
+     */
+    static_assert(binary_type_of<T>() != BinaryType::none,
+        "type cannot be stored in a binary file");
+
+    const char *payload = reinterpret_cast<const char *>(values);
+    std::vector<char> swapped;
+    const std::size_t payload_size = count * sizeof(T);
+    if (!host_is_little_endian()) {
+        using Bits = std::conditional_t<sizeof(T) == 8, std::uint64_t,
+            std::uint32_t>;
+        swapped.resize(payload_size);
+        for (std::size_t i = 0; i < count; i++) {
+            Bits bits;
+            std::memcpy(&bits, values + i, sizeof(T));
+            store_le<Bits>(swapped.data() + i * sizeof(T), bits);
+        }
+        payload = swapped.data();
+    }
+
+    char header[binary_header_size];
+    encode_binary_header(header, binary_type_of<T>(), count,
+        binary_checksum(payload, payload_size));
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error Opening Output File" << std::endl;
+        return 0;
+    }
+    struct iovec iov[2] = {{header, binary_header_size},
+        {const_cast<char *>(payload), payload_size}};
+    ssize_t written = writev(fd, iov, 2);
+    int ret = 1;
+    if (written < 0) {
+        written = 0;
+        ret = (errno == EINTR);
+    }
+    // Finish a short write
+    std::size_t done = written;
+    if (ret && done < binary_header_size) {
+        ret = write_fully(fd, header + done, binary_header_size - done);
+        done = binary_header_size;
+    }
+    if (ret) {
+        ret = write_fully(fd, payload + (done - binary_header_size),
+            payload_size - (done - binary_header_size));
+    }
+    if (close(fd) != 0 || !ret) {
+        std::cerr << "Error Writing Output File" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+template <typename T>
+void encode_binary_file(const T *values, const std::size_t count,
+    std::vector<char> &out) {
+    /**
+     * Encodes values as the contents of a binary file, for writers that do
+     *  not write through a file descriptor of their own
+     *
+     * Parameters:
+     *      values (const T *)  :   values to store
+     *      count (size_t)      :   number of values
+     *      out (vector<char> &):   set to the header and payload
+     */
+    static_assert(binary_type_of<T>() != BinaryType::none,
+        "type cannot be stored in a binary file");
+
+    using Bits = std::conditional_t<sizeof(T) == 8, std::uint64_t,
+        std::uint32_t>;
+    out.resize(binary_header_size + count * sizeof(T));
+    char *payload = out.data() + binary_header_size;
+    if (host_is_little_endian()) {
+        std::memcpy(payload, values, count * sizeof(T));
+    }
+    else {
+        for (std::size_t i = 0; i < count; i++) {
+            Bits bits;
+            std::memcpy(&bits, values + i, sizeof(T));
+            store_le<Bits>(payload + i * sizeof(T), bits);
+        }
+    }
+    encode_binary_header(out.data(), binary_type_of<T>(), count,
+        binary_checksum(payload, count * sizeof(T)));
+}
+
+template <typename T>
+class BinaryWriter {
+    /**
+     * Writes a binary file whose values arrive in pieces, for files that do
+     *  not fit in memory. The header is written last, once the count and
+     *  checksum are known
+     */
+
+    private:
+        int fd = -1;
+        std::vector<char> buffer;
+        std::size_t used = 0;
+        std::uint64_t count = 0;
+        std::uint64_t checksum = binary_checksum_basis;
+        bool failed = false;
+
+        void flush();
+
+    public:
+        BinaryWriter(const std::string &filename,
+            const std::size_t buffer_bytes = 1 << 20);
+        ~BinaryWriter();
+        BinaryWriter(const BinaryWriter &) = delete;
+        BinaryWriter &operator=(const BinaryWriter &) = delete;
+
+        void append(const T *values, const std::size_t n);
+        int finish();
+};
+
+template <typename T>
+BinaryWriter<T>::BinaryWriter(const std::string &filename,
+    const std::size_t buffer_bytes)
+    : buffer((buffer_bytes < 64 ? 64 : buffer_bytes) / 8 * 8) {
+    /**
+     * Creates the file and reserves room for the header
+     *
+     * Parameters:
+     *      filename (string)       :   file to write
+     *      buffer_bytes (size_t)   :   bytes written per write call
+     */
+    static_assert(binary_type_of<T>() != BinaryType::none,
+        "type cannot be stored in a binary file");
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    failed = (fd < 0) || lseek(fd, binary_header_size, SEEK_SET) < 0;
+}
+
+template <typename T>
+BinaryWriter<T>::~BinaryWriter() {
+    /**
+     * Closes the file if finish was not called
+     */
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+template <typename T>
+void BinaryWriter<T>::flush() {
+    /**
+     * Hashes and writes the buffered payload bytes
+     */
+    checksum = binary_checksum(buffer.data(), used, checksum);
+    if (!failed) {
+        failed = !write_fully(fd, buffer.data(), used);
+    }
+    used = 0;
+}
+
+template <typename T>
+void BinaryWriter<T>::append(const T *values, const std::size_t n) {
+    /**
+     * Appends values to the payload
+     *
+     * Parameters:
+     *      values (const T *)  :   values to append
+     *      n (size_t)          :   number of values
+     */
+    using Bits = std::conditional_t<sizeof(T) == 8, std::uint64_t,
+        std::uint32_t>;
+    for (std::size_t i = 0; i < n; i++) {
+        if (used == buffer.size()) {
+            flush();
+        }
+        Bits bits;
+        std::memcpy(&bits, values + i, sizeof(T));
+        store_le<Bits>(buffer.data() + used, bits);
+        used += sizeof(T);
+    }
+    count += n;
+}
+
+template <typename T>
+int BinaryWriter<T>::finish() {
+    /**
+     * Writes the remaining payload and the header and closes the file
+     *
+     * Returns:
+     *      int :   1 if the file was written, 0 if not
+     */
+    flush();
+    char header[binary_header_size];
+    encode_binary_header(header, binary_type_of<T>(), count, checksum);
+    if (!failed) {
+        failed = pwrite(fd, header, binary_header_size, 0)
+            != static_cast<ssize_t>(binary_header_size);
+    }
+    if (fd >= 0 && close(fd) != 0) {
+        failed = true;
+    }
+    fd = -1;
+    if (failed) {
+        std::cerr << "Error Writing Output File" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+#endif  // BINARY_FORMAT_H
@@ -0,0 +1,108 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     BoundedQueue.h
+ *
+ * This header implements a blocking queue with a fixed capacity used to pass
+ *   files between the stages of the batch pipeline in Azeem_Musa_QuickSort.cpp
+ *  - push blocks while the queue is full, which caps the memory held by
+ *    files that are waiting for the next stage
+ *  - pop blocks while the queue is empty until an item arrives or the queue
+ *    is closed
+ */
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template <typename T>
+class BoundedQueue {
+
+    private:
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<T> items;
+        std::size_t capacity;
+        bool closed = false;
+
+    public:
+        explicit BoundedQueue(const std::size_t capacity);
+        bool push(T item);
+        bool pop(T &item);
+        void close();
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(const std::size_t capacity)
+    : capacity(capacity == 0 ? 1 : capacity) {
+    /**
+     * Parameters:
+     *      capacity (size_t)   :   most items the queue holds at once
+     */
+}
+
+template <typename T>
+bool BoundedQueue<T>::push(T item) {
+    /**
+     * Adds an item, waiting while the queue is full
+     *
+     * Parameters:
+     *      item (T)    :   item to add
+     *
+     * Returns:
+     *      bool    :   false if the queue was closed and the item was dropped
+     */
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+    if (closed) {
+        return false;
+    }
+    items.push_back(std::move(item));
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T &item) {
+    /**
+     * Removes the oldest item, waiting while the queue is empty
+     *
+     * Parameters:
+     *      item (T &)  :   set to the removed item
+     *
+     * Returns:
+     *      bool    :   false once the queue is closed and empty
+     */
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+    if (items.empty()) {
+        return false;
+    }
+    item = std::move(items.front());
+    items.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+}
+
+template <typename T>
+void BoundedQueue<T>::close() {
+    /**
+     * Wakes all waiting threads; remaining items can still be popped
+     */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+#endif  // BOUNDED_QUEUE_H
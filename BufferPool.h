@@ -0,0 +1,143 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     BufferPool.h
+ *
+ * This header implements the arena mode of Azeem_Musa_QuickSort.cpp, which
+ *   reuses the memory of one file for the next instead of allocating again
+ *  - BufferPool keeps the arrays of finished files, so the batch pipeline
+ *    hands their capacity to the files it reads next
+ *  - advise_huge_pages asks the kernel to back a large buffer with
+ *    transparent huge pages, so sorting touches fewer TLB entries
+ *  - Heap allocations are counted in allocation_count and allocation_bytes.
+ *    Azeem_Musa_QuickSort.cpp replaces operator new to update them in
+ *    builds with QUICKSORT_INSTRUMENT (make instrument=1)
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+// Heap allocations made by the program and their total size
+inline std::atomic<std::uint64_t> allocation_count{0};
+inline std::atomic<std::uint64_t> allocation_bytes{0};
+// Buffers advised to use huge pages and their total size
+inline std::atomic<std::uint64_t> huge_page_buffers{0};
+inline std::atomic<std::uint64_t> huge_page_bytes{0};
+
+// Size of a transparent huge page on x86-64 and aarch64
+constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+
+// Counters at one point of a run, subtracted to get the allocations between
+//  two points
+struct AllocationStats {
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t huge_buffers = 0;
+    std::uint64_t huge_bytes = 0;
+};
+
+inline AllocationStats allocation_snapshot() {
+    /**
+     * Returns:
+     *      AllocationStats :   current value of every allocation counter
+     */
+    AllocationStats stats;
+    stats.count = allocation_count.load(std::memory_order_relaxed);
+    stats.bytes = allocation_bytes.load(std::memory_order_relaxed);
+    stats.huge_buffers = huge_page_buffers.load(std::memory_order_relaxed);
+    stats.huge_bytes = huge_page_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+inline void advise_huge_pages(void *data, const std::size_t bytes) {
+    /**
+     * Advises the huge pages that lie completely inside a buffer to be
+     *  backed by transparent huge pages. Must be called before the buffer
+     *  is first written to, since pages already faulted in stay small
+     * Buffers smaller than two huge pages are left alone
+     *
+     * Parameters:
+     *      data (void *)   :   start of the buffer
+     *      bytes (size_t)  :   size of the buffer
+     */
+    if (data == nullptr || bytes < 2 * huge_page_size) {
+        return;
+    }
+    std::uintptr_t first = (reinterpret_cast<std::uintptr_t>(data)
+        + huge_page_size - 1) & ~(huge_page_size - 1);
+    std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(data) + bytes)
+        & ~(huge_page_size - 1);
+#ifdef MADV_HUGEPAGE
+    if (last > first && madvise(reinterpret_cast<void *>(first),
+        last - first, MADV_HUGEPAGE) == 0) {
+        huge_page_buffers.fetch_add(1, std::memory_order_relaxed);
+        huge_page_bytes.fetch_add(last - first, std::memory_order_relaxed);
+    }
+#else
+    (void)first;
+    (void)last;
+#endif
+}
+
+template <typename T>
+class BufferPool {
+
+    private:
+        std::mutex mutex;
+        std::vector<std::vector<T>> buffers;
+        std::size_t capacity;
+
+    public:
+        explicit BufferPool(const std::size_t capacity);
+        std::vector<T> acquire();
+        void release(std::vector<T> buffer);
+};
+
+template <typename T>
+BufferPool<T>::BufferPool(const std::size_t capacity) : capacity(capacity) {
+    /**
+     * Parameters:
+     *      capacity (size_t)   :   most buffers kept for reuse
+     */
+}
+
+template <typename T>
+std::vector<T> BufferPool<T>::acquire() {
+    /**
+     * Returns:
+     *      (vector<T>) :   an empty buffer that keeps the capacity of a
+     *                      released one, or a new empty buffer
+     */
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffers.empty()) {
+        return std::vector<T>();
+    }
+    std::vector<T> buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+template <typename T>
+void BufferPool<T>::release(std::vector<T> buffer) {
+    /**
+     * Keeps a buffer for a later acquire, or frees it if the pool is full
+     *
+     * Parameters:
+     *      buffer (vector<T>)  :   buffer that is no longer used
+     */
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffers.size() < capacity) {
+        buffers.push_back(std::move(buffer));
+    }
+}
+
+#endif  // BUFFER_POOL_H
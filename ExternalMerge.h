@@ -0,0 +1,278 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     ExternalMerge.h
+ *
+ * This header implements the merge stage of the external sort in
+ *   Azeem_Musa_QuickSort.cpp
+ *  - RunReader streams the values of a sorted run file through a large
+ *    buffer, so every run is read with big sequential reads
+ *  - LoserTree selects the smallest head of k runs with one comparison per
+ *    level of the tree (log2(k) per value) instead of the 2*log2(k) of a
+ *    binary heap. Ties go to the lower run index, so the merge is stable
+ */
+
+#ifndef EXTERNAL_MERGE_H
+#define EXTERNAL_MERGE_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BinaryFormat.h"
+
+template <typename T>
+class RunReader {
+
+    private:
+        int fd;
+        std::vector<T> buffer;
+        std::size_t pos = 0;        // next value in the buffer
+        std::size_t len = 0;        // values in the buffer
+        bool failed = false;
+
+        bool refill();
+
+    public:
+        RunReader(const std::string &path, const std::size_t buffer_values);
+        ~RunReader();
+        RunReader(const RunReader &) = delete;
+        RunReader &operator=(const RunReader &) = delete;
+
+        bool ok() const;
+        bool next(T &value);
+};
+
+template <typename T>
+RunReader<T>::RunReader(const std::string &path,
+    const std::size_t buffer_values)
+    : buffer(buffer_values == 0 ? 1 : buffer_values) {
+    /**
+     * Opens a run file of raw values of type T
+     *
+     * Parameters:
+     *      path (string)           :   run file to read
+     *      buffer_values (size_t)  :   values read per read call
+     */
+    fd = open(path.c_str(), O_RDONLY);
+    failed = (fd < 0);
+    if (!failed) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+}
+
+template <typename T>
+RunReader<T>::~RunReader() {
+    /**
+     * Closes the run file
+     */
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+template <typename T>
+bool RunReader<T>::ok() const {
+    /**
+     * Returns:
+     *      bool    :   false if the run could not be opened or read
+     */
+    return !failed;
+}
+
+template <typename T>
+bool RunReader<T>::refill() {
+    /**
+     * Reads the next block of the run into the buffer
+     *
+     * Returns:
+     *      bool    :   true if at least one value was read
+     */
+    if (failed) {
+        return false;
+    }
+    ssize_t bytes = read_fully(fd, reinterpret_cast<char *>(buffer.data()),
+        buffer.size() * sizeof(T));
+    if (bytes < 0) {
+        failed = true;
+        return false;
+    }
+    pos = 0;
+    len = bytes / sizeof(T);
+    return len > 0;
+}
+
+template <typename T>
+bool RunReader<T>::next(T &value) {
+    /**
+     * Parameters:
+     *      value (T &) :   set to the next value of the run
+     *
+     * Returns:
+     *      bool    :   false once the run is exhausted
+     */
+    if (pos == len && !refill()) {
+        return false;
+    }
+    value = buffer[pos++];
+    return true;
+}
+
+template <typename T, typename Compare>
+class LoserTree {
+
+    private:
+        std::size_t k;
+        std::vector<std::size_t> tree;  // tree[0] = winner, others = losers
+        std::vector<T> keys;            // current head of each run
+        std::vector<char> done;         // run is exhausted
+        Compare comp;
+
+        bool beats(const std::size_t a, const std::size_t b) const;
+        void replay(std::size_t leaf);
+
+    public:
+        LoserTree(const std::size_t k, Compare comp = Compare());
+
+        void set(const std::size_t run, T key);
+        void finish(const std::size_t run);
+        void init();
+
+        bool empty() const;
+        std::size_t top() const;
+        const T &top_key() const;
+        void replace_top(T key);
+        void finish_top();
+};
+
+template <typename T, typename Compare>
+LoserTree<T, Compare>::LoserTree(const std::size_t k, Compare comp)
+    : k(k == 0 ? 1 : k), tree(this->k, 0), keys(this->k),
+      done(this->k, 1), comp(comp) {
+    /**
+     * Creates a tree for k runs, all exhausted until set is called
+     *
+     * Parameters:
+     *      k (size_t)          :   number of runs
+     *      comp (Compare)      :   ordering of the runs
+     */
+}
+
+template <typename T, typename Compare>
+bool LoserTree<T, Compare>::beats(const std::size_t a,
+    const std::size_t b) const {
+    /**
+     * Returns:
+     *      bool    :   true if the head of run a comes before the head of b
+     */
+    if (done[a] || done[b]) {
+        return !done[a];
+    }
+    if (comp(keys[a], keys[b])) {
+        return true;
+    }
+    return !comp(keys[b], keys[a]) && a < b;
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::set(const std::size_t run, T key) {
+    /**
+     * Sets the first value of a run before init
+     */
+    keys[run] = std::move(key);
+    done[run] = 0;
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::finish(const std::size_t run) {
+    /**
+     * Marks a run as empty before init
+     */
+    done[run] = 1;
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::init() {
+    /**
+     * Plays the initial tournament. Leaves are nodes k to 2k-1 of an
+     *  implicit binary tree, so any k works
+     */
+    std::vector<std::size_t> winner(2 * k);
+    for (std::size_t i = 0; i < k; i++) {
+        winner[k + i] = i;
+    }
+    for (std::size_t n = k - 1; n >= 1; n--) {
+        std::size_t a = winner[2 * n];
+        std::size_t b = winner[2 * n + 1];
+        winner[n] = beats(a, b) ? a : b;
+        tree[n] = beats(a, b) ? b : a;
+    }
+    tree[0] = (k == 1) ? 0 : winner[1];
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::replay(std::size_t leaf) {
+    /**
+     * Replays the matches from a changed leaf up to the root
+     *
+     * Parameters:
+     *      leaf (size_t)   :   run whose head changed
+     */
+    std::size_t winner = leaf;
+    for (std::size_t n = (leaf + k) / 2; n >= 1; n /= 2) {
+        if (beats(tree[n], winner)) {
+            std::swap(tree[n], winner);
+        }
+    }
+    tree[0] = winner;
+}
+
+template <typename T, typename Compare>
+bool LoserTree<T, Compare>::empty() const {
+    /**
+     * Returns:
+     *      bool    :   true once every run is exhausted
+     */
+    return done[tree[0]];
+}
+
+template <typename T, typename Compare>
+std::size_t LoserTree<T, Compare>::top() const {
+    /**
+     * Returns:
+     *      size_t  :   run holding the smallest head
+     */
+    return tree[0];
+}
+
+template <typename T, typename Compare>
+const T &LoserTree<T, Compare>::top_key() const {
+    /**
+     * Returns:
+     *      (const T &) :   the smallest head
+     */
+    return keys[tree[0]];
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::replace_top(T key) {
+    /**
+     * Replaces the smallest head with the next value of its run
+     */
+    keys[tree[0]] = std::move(key);
+    replay(tree[0]);
+}
+
+template <typename T, typename Compare>
+void LoserTree<T, Compare>::finish_top() {
+    /**
+     * Marks the run holding the smallest head as exhausted
+     */
+    done[tree[0]] = 1;
+    replay(tree[0]);
+}
+
+#endif  // EXTERNAL_MERGE_H
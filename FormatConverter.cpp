@@ -0,0 +1,238 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     FormatConverter.cpp
+ *
+ * This C++ program converts input and sorted files between the ASCII format
+ *   and the binary format (see BinaryFormat.h)
+ *  - ASCII files are converted to binary files of the given type
+ *  - Binary files are converted to ASCII files, as their stored type unless
+ *    a type is given
+ * The direction is chosen from the header of the input file
+ *
+ * Usage: ./FormatConverter [Input File] [Output File]
+ *                          [double|float|int64|uint32]
+ *
+ * Output Format:
+ *  - ASCII output holds values seperated by a blank space, each in its
+ *    shortest form that parses back to exactly the same value
+ *  - Binary output holds a header and the raw values (default type: double)
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BinaryFormat.h"
+#include "TextFormat.h"
+
+int convert_file(const std::string in_path, const std::string out_path,
+    BinaryType type);
+template <typename T>
+int ascii_to_binary(const char *first, const char *last,
+    const std::string out_path);
+template <typename T>
+int binary_to_ascii(const char *first, const std::size_t size,
+    const BinaryHeader &header, const std::string out_path);
+
+int main(int argc, char **argv) {
+    if (argc != 3 && argc != 4) {
+        std::cout << "Usage: ./FormatConverter [Input File] [Output File]"
+            << " [double|float|int64|uint32]" << std::endl;
+        return 1;
+    }
+
+    BinaryType type = BinaryType::none;     // none = keep the stored type
+    if (argc == 4) {
+        std::string name = argv[3];
+        if (name == "double") {
+            type = BinaryType::float64;
+        }
+        else if (name == "float") {
+            type = BinaryType::float32;
+        }
+        else if (name == "int64") {
+            type = BinaryType::int64;
+        }
+        else if (name == "uint32") {
+            type = BinaryType::uint32;
+        }
+        else {
+            std::cout << "Unknown type: " << name << std::endl;
+            return 1;
+        }
+    }
+
+    if (!convert_file(argv[1], argv[2], type)) {
+        std::cout << "Failed to convert file" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int convert_file(const std::string in_path, const std::string out_path,
+    BinaryType type) {
+    /**
+     * Maps the input file and converts it to the other format
+     *
+     * Parameters:
+     *  in_path (string)    :   file to convert
+     *  out_path (string)   :   file to write
+     *  type (BinaryType)   :   type of the output values, none to keep the
+     *                          stored type of a binary file (double for ASCII)
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if successful, 0 if not
+     */
+
+    int fd = open(in_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error Opening Input File" << std::endl;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        std::cerr << "Error Opening Input File" << std::endl;
+        return 0;
+    }
+    std::size_t size = st.st_size;
+    const char *first = "";
+    void *data = MAP_FAILED;
+    if (size > 0) {
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            std::cerr << "Error Mapping Input File" << std::endl;
+            return 0;
+        }
+        madvise(data, size, MADV_SEQUENTIAL);
+        first = static_cast<const char *>(data);
+    }
+
+    int ret = 0;
+    if (is_binary_file(first, size)) {
+        BinaryHeader header;
+        if (decode_binary_header(first, size, header)) {
+            if (type == BinaryType::none) {
+                type = header.type;
+            }
+            switch (type) {
+                case BinaryType::float64:
+                    ret = binary_to_ascii<double>(first, size, header, out_path);
+                    break;
+                case BinaryType::float32:
+                    ret = binary_to_ascii<float>(first, size, header, out_path);
+                    break;
+                case BinaryType::int64:
+                    ret = binary_to_ascii<std::int64_t>(first, size, header,
+                        out_path);
+                    break;
+                default:
+                    ret = binary_to_ascii<std::uint32_t>(first, size, header,
+                        out_path);
+                    break;
+            }
+        }
+    }
+    else {
+        switch (type) {
+            case BinaryType::float32:
+                ret = ascii_to_binary<float>(first, first + size, out_path);
+                break;
+            case BinaryType::int64:
+                ret = ascii_to_binary<std::int64_t>(first, first + size,
+                    out_path);
+                break;
+            case BinaryType::uint32:
+                ret = ascii_to_binary<std::uint32_t>(first, first + size,
+                    out_path);
+                break;
+            default:
+                ret = ascii_to_binary<double>(first, first + size, out_path);
+                break;
+        }
+    }
+
+    if (data != MAP_FAILED) {
+        munmap(data, size);
+    }
+    close(fd);
+    return ret;
+}
+
+template <typename T>
+int ascii_to_binary(const char *first, const char *last,
+    const std::string out_path) {
+    /**
+     * Parses whitespace separated values (see TextFormat.h) and writes
+     *  them to a binary file
+     *
+     * Parameters:
+     *  first (const char *)    :   start of the text
+     *  last (const char *)     :   end of the text
+     *  out_path (string)       :   binary file to write
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if successful, 0 if not
+     */
+
+    std::vector<T> values;
+    values.reserve(estimate_text_values(first, last));
+    parse_text_values<T>(first, last, SIZE_MAX,
+        [&values](const T value) { values.push_back(value); });
+    return write_binary_file(out_path, values.data(), values.size());
+}
+
+template <typename T>
+int binary_to_ascii(const char *first, const std::size_t size,
+    const BinaryHeader &header, const std::string out_path) {
+    /**
+     * Checks the checksum of a binary file and writes its values as text,
+     *  formatted into a 1 MiB buffer (see TextFormat.h)
+     *
+     * Parameters:
+     *  first (const char *)        :   start of the binary file
+     *  size (size_t)               :   size of the binary file
+     *  header (const BinaryHeader&):   decoded header of the file
+     *  out_path (string)           :   ASCII file to write
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if successful, 0 if not
+     */
+
+    const char *payload = first + binary_header_size;
+    if (binary_checksum(payload, size - binary_header_size)
+        != header.checksum) {
+        std::cerr << "Binary input file checksum mismatch" << std::endl;
+        return 0;
+    }
+    std::vector<T> values(header.count);
+    decode_binary_values(payload, header, values.data());
+
+    int fd = open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error Opening Output File" << std::endl;
+        return 0;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    int ret = 1;
+    std::size_t next = 0;
+    while (next < values.size() && ret) {
+        std::size_t len = format_text_values(values.data(), values.size(),
+            next, buffer.data(), buffer.size());
+        ret = write_fully(fd, buffer.data(), len);
+    }
+
+    if (close(fd) != 0 || !ret) {
+        std::cerr << "Error Writing Output File" << std::endl;
+        return 0;
+    }
+    return 1;
+}
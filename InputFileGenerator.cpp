@@ -2,21 +2,69 @@
  * Author :     Musa Azeem
  * Date   :     12/2/2022
  * File   :     InputFileGenerator.cpp
- * 
+ *
  * This C++ program produces random input files to test and time the quick sort
  *   implementation in Azeem_Musa_QuickSort.cpp
- * It generates 75 random input files (25 each of 10, 100, and 1000 
+ * By default it generates 75 random input files (25 each of 10, 100, and 1000
  *   floating point numbers)
- * 
- * Usage: ./InputFileGenerator [Output Directory]
- * 
- * 
+ *
+ * Usage: ./InputFileGenerator [Output Directory] [Distribution] [Format]
+ *                             [Values] [--files=N] [--sizes=N,N,...]
+ *                             [--seed=N] [--threads=N]
+ *
+ * If Values is given, a single large file of that many values is generated
+ *   instead (e.g. 500000000 values for a multi-GB input for the external
+ *   sort). It is the same as --sizes=Values --files=1
+ *
+ * Options:
+ *  --files     :   Number of files of each size (default: 25)
+ *  --sizes     :   Comma separated numbers of values per file
+ *                  (default: 10,100,1000)
+ *  --seed      :   Seed of the run (default: random, printed so the files
+ *                  can be generated again)
+ *  --threads   :   Threads that generate values (default: number of hardware
+ *                  threads)
+ *
+ * Every file is split into blocks of 2^17 values, and every block is drawn
+ *   from its own WyRand stream (see Random.h) derived from the seed, the
+ *   file size, the file number and the block number. Files are generated in
+ *   parallel, and the blocks of a large file are generated in parallel and
+ *   written in order, so it never has to fit in memory. The same seed writes
+ *   the same files with any number of threads
+ *
+ * Distributions:
+ *  - uniform    :   uniformly distributed values in [-100000, 100000) (default)
+ *  - normal     :   normally distributed values with mean 0 and standard
+ *                   deviation 20000
+ *  - zipf       :   integers 1 to 65536 where value k is drawn with a
+ *                   probability proportional to 1/k^1.1, like word counts
+ *  - few-unique :   values quantized to 16 levels in [-100000, 100000), which
+ *                   produces long runs of repeated values like sensor feeds
+ *  - sorted     :   uniform values in ascending order
+ *  - reverse    :   uniform values in descending order
+ *  - nearly-sorted
+ *               :   4 ascending runs of uniform values one after another,
+ *                   like logs appended from a few sources
+ *  - organ-pipe :   uniform values ascending to the middle of the file and
+ *                   descending after it
+ *  - killer     :   a permutation of 1 to num_of_values that drives quick
+ *                   sort with median-of-3 pivots to quadratic time (Musser)
+ * The ordered distributions place one value in each of num_of_values equal
+ *   slices of [-100000, 100000), so large files need no sorting
+ *
+ * Formats:
+ *  - ascii      :   random floating-point numbers seperated by whitespace
+ *                   (default)
+ *  - binary     :   binary files of doubles (see BinaryFormat.h)
+ *
  * Output Format:
- *  - Output files are ASCII and contain random floating-point numbers
- *    seperated by whitespace
- *  - Output files are saved within the given directory, in subdirectories 
- *      10, 100, and 1000 for each input size:
- *  - Filenames are in format, input-file-1, ... , input-file-25
+ *  - Output files contain random floating-point numbers in the given format,
+ *    written in their shortest round trip form. zipf, few-unique and killer
+ *    values are written as integers
+ *  - Output files are saved within the given directory, in subdirectories
+ *      10, 100, and 1000 (or the given sizes) for each input size:
+ *  - Filenames are in format, input-file-1, ... , input-file-25, with a .txt
+ *    extension for ASCII files and .bin for binary files
  */
 
 #include <iostream>
@@ -24,83 +72,632 @@
 #include <fstream>
 #include <cstdlib>
 #include <filesystem>
-#include <random>
+#include <vector>
+#include <charconv>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "BinaryFormat.h"
+#include "Random.h"
+#include "ThreadPool.h"
 
 namespace fs = std::filesystem;
 
-int generate_files(std::string dir);
-int generate_files(int num_of_files, int num_of_values, std::string dir);
+enum class Distribution {
+    uniform, normal, zipf, few_unique, sorted, reverse, nearly_sorted,
+    organ_pipe, killer
+};
+
+const std::map<std::string, Distribution> distribution_names = {
+    {"uniform", Distribution::uniform},
+    {"normal", Distribution::normal},
+    {"zipf", Distribution::zipf},
+    {"few-unique", Distribution::few_unique},
+    {"sorted", Distribution::sorted},
+    {"reverse", Distribution::reverse},
+    {"nearly-sorted", Distribution::nearly_sorted},
+    {"organ-pipe", Distribution::organ_pipe},
+    {"killer", Distribution::killer}
+};
+
+struct GeneratorOptions {
+    std::string dir;
+    Distribution distribution = Distribution::uniform;
+    FileFormat format = FileFormat::ascii;
+    long long num_of_files = 25;
+    std::vector<long long> sizes = {10, 100, 1000};
+    std::uint64_t seed = 0;
+    unsigned threads = 1;
+};
+
+int parse_options(int argc, char **argv, GeneratorOptions &opts);
+int parse_count(const std::string &value, long long &count);
+int generate_files(const GeneratorOptions &opts);
+int generate_file(const GeneratorOptions &opts, long long num_of_values,
+    long long file, const std::vector<double> &zipf_cdf);
+int generate_large_file(const GeneratorOptions &opts, ThreadPool &pool,
+    long long num_of_values, long long file,
+    const std::vector<double> &zipf_cdf);
+std::string file_path(const GeneratorOptions &opts, long long num_of_values,
+    long long file);
+void fill_block(double *values, std::size_t n, long long first,
+    long long num_of_values, Distribution distribution, std::uint64_t seed,
+    const std::vector<double> &zipf_cdf);
+std::size_t format_block(const double *values, std::size_t n,
+    Distribution distribution, std::vector<char> &text);
+std::vector<double> zipf_table();
+bool is_integer(Distribution distribution);
+bool is_ordered(Distribution distribution);
+double ordered_value(long long index, long long num_of_values,
+    Distribution distribution, double offset);
+double killer_value(long long index, long long num_of_values);
+
+// Values per block: every block is drawn from its own stream
+const std::size_t block_values = 1 << 17;   // 1 MiB of doubles
+// Longest text of one value and its separator
+const std::size_t max_value_chars = 32;
+// Ascending runs of the nearly-sorted distribution
+const long long nearly_sorted_runs = 4;
+// Ranks and exponent of the zipf distribution
+const std::size_t zipf_ranks = 1 << 16;
+const double zipf_exponent = 1.1;
+// Standard deviation of the normal distribution
+const double normal_deviation = 20000;
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cout << "Usage: ./InputFileGenerator [Output Directory]" << std::endl;
+    GeneratorOptions opts;
+    opts.seed = random_seed();
+    opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!parse_options(argc, argv, opts)) {
+        std::cout << "Usage: ./InputFileGenerator [Output Directory]"
+            << " [uniform|normal|zipf|few-unique|sorted|reverse"
+            << "|nearly-sorted|organ-pipe|killer]"
+            << " [ascii|binary] [Values] [--files=N] [--sizes=N,N,...]"
+            << " [--seed=N] [--threads=N]" << std::endl;
         return 1;
     }
 
-    std::string dir = argv[1];
-    if (!generate_files(dir)) {
-        // Create directory if doesn't exist
+    std::cout << "Seed: " << opts.seed << " (replay with --seed="
+        << opts.seed << ")" << std::endl;
+    if (!generate_files(opts)) {
         std::cout << "Failed to write files" << std::endl;
+        return 1;
     }
+    return 0;
 }
 
-int generate_files(std::string dir) {
+int parse_options(int argc, char **argv, GeneratorOptions &opts) {
     /**
-     * Generates ASCII files with random floating point numbers,
-     *  seperated by whitespaces
-     * Generates 75 files:
-     *  - 25 with 10 values
-     *  - 25 with 100 values
-     *  - 25 with 1000 values
+     * Reads the positional arguments and the options
+     *
+     * Parameters:
+     *  argc (int)                  :   number of arguments
+     *  argv (char **)              :   arguments
+     *  opts (GeneratorOptions &)   :   set from the arguments
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if the arguments are valid, 0 if not
      */
 
-    // Create Directories
-    fs::create_directory(dir);
-    fs::create_directory(fs::path(dir+"/10"));
-    fs::create_directory(fs::path(dir+"/100"));
-    fs::create_directory(fs::path(dir+"/1000"));
-
-    if (!generate_files(25, 10, dir) ||
-        !generate_files(25, 100, dir) ||
-        !generate_files(25, 1000, dir)) {
-        
+    std::vector<std::string> positional;
+    bool files_given = false;
+    bool sizes_given = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        std::size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq+1);
+
+        if (name == "--files") {
+            if (!parse_count(value, opts.num_of_files)) {
+                std::cout << "Invalid number of files: " << value << std::endl;
+                return 0;
+            }
+            files_given = true;
+        }
+        else if (name == "--sizes") {
+            // Comma separated list of sizes
+            opts.sizes.clear();
+            std::istringstream iss(value);
+            std::string size;
+            while (std::getline(iss, size, ',')) {
+                long long num_of_values;
+                if (!parse_count(size, num_of_values)) {
+                    std::cout << "Invalid number of values: " << size
+                        << std::endl;
+                    return 0;
+                }
+                opts.sizes.push_back(num_of_values);
+            }
+            if (opts.sizes.empty()) {
+                std::cout << "No size given" << std::endl;
+                return 0;
+            }
+            sizes_given = true;
+        }
+        else if (name == "--seed") {
+            try {
+                std::size_t end = 0;
+                if (value.empty() || value[0] == '-') {
+                    throw std::invalid_argument(value);
+                }
+                opts.seed = std::stoull(value, &end);
+                if (end != value.size()) {
+                    throw std::invalid_argument(value);
+                }
+            }
+            catch (const std::exception &e) {
+                std::cout << "Invalid seed: " << value << std::endl;
+                return 0;
+            }
+        }
+        else if (name == "--threads") {
+            long long threads;
+            if (!parse_count(value, threads) || threads > 4096) {
+                std::cout << "Invalid thread count: " << value << std::endl;
+                return 0;
+            }
+            opts.threads = static_cast<unsigned>(threads);
+        }
+        else {
+            std::cout << "Unknown option: " << arg << std::endl;
+            return 0;
+        }
+    }
+
+    if (positional.empty() || positional.size() > 4) {
+        return 0;
+    }
+    opts.dir = positional[0];
+    if (positional.size() >= 2) {
+        if (!distribution_names.count(positional[1])) {
+            std::cout << "Unknown distribution: " << positional[1]
+                << std::endl;
+            return 0;
+        }
+        opts.distribution = distribution_names.at(positional[1]);
+    }
+    std::string format_name = (positional.size() >= 3)
+        ? positional[2] : "ascii";
+    if (format_name != "ascii" && format_name != "binary") {
+        std::cout << "Unknown format: " << format_name << std::endl;
         return 0;
     }
+    opts.format = (format_name == "binary")
+        ? FileFormat::binary : FileFormat::ascii;
+    if (positional.size() == 4) {
+        // A single large file, unless the options say otherwise
+        long long num_of_values;
+        if (!parse_count(positional[3], num_of_values)) {
+            std::cout << "Invalid number of values: " << positional[3]
+                << std::endl;
+            return 0;
+        }
+        if (!sizes_given) {
+            opts.sizes = {num_of_values};
+        }
+        if (!files_given) {
+            opts.num_of_files = 1;
+        }
+    }
     return 1;
 }
 
-int generate_files(int num_of_files, int num_of_values, std::string dir) {
+int parse_count(const std::string &value, long long &count) {
     /**
-     * Generates <number_of_files> files, 
-     *   each with <num_of_values> random values
-     * 
      * Parameters:
-     *  num_of_files (int)  :   Number of files to generate
-     *  num_of_values (int) :   Number of random values to generate
-     * 
+     *  value (string)      :   text of a positive number
+     *  count (long long &) :   set to the number
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if value is a whole positive number, 0 if not
+     */
+    try {
+        std::size_t end = 0;
+        long long parsed = std::stoll(value, &end);
+        if (end != value.size() || parsed < 1) {
+            return 0;
+        }
+        count = parsed;
+        return 1;
+    }
+    catch (const std::exception &e) {
+        return 0;
+    }
+}
+
+int generate_files(const GeneratorOptions &opts) {
+    /**
+     * Generates <num_of_files> files of every size. Files of at most one
+     *  block are generated in parallel, one file per task, and larger files
+     *  one after another with their blocks generated in parallel
+     *
+     * Parameters:
+     *  opts (GeneratorOptions) :   directory, distribution, format, sizes,
+     *                              seed and threads of the run
+     *
      * Returns:
      *  (int)   :   Returns 1 if successful, 0 if not
-    */
+     */
+
+    // Create Directories
+    std::error_code ec;
+    for (long long num_of_values : opts.sizes) {
+        fs::create_directories(
+            fs::path(opts.dir + "/" + std::to_string(num_of_values)), ec);
+        if (ec) {
+            return 0;
+        }
+    }
 
-    for (int i=0; i<num_of_files; i++) {
+    // The zipf distribution draws ranks from a table shared by all threads
+    std::vector<double> zipf_cdf;
+    if (opts.distribution == Distribution::zipf) {
+        zipf_cdf = zipf_table();
+    }
 
-        std::filesystem::path p(dir + "/" + std::to_string(num_of_values)
-            + "/input-file-" + std::to_string(i+1) + ".txt");
+    ThreadPool pool(opts.threads);
+    TaskGroup group;
+    std::atomic<bool> failed{false};
+    for (long long num_of_values : opts.sizes) {
+        if (num_of_values > static_cast<long long>(block_values)) {
+            continue;
+        }
+        for (long long file = 0; file < opts.num_of_files; file++) {
+            pool.run(group, [&, num_of_values, file]() {
+                if (!generate_file(opts, num_of_values, file, zipf_cdf)) {
+                    failed = true;
+                }
+            });
+        }
+    }
+    pool.wait(group);
+    if (failed) {
+        return 0;
+    }
 
-        std::ofstream out_file(p);
-        if (out_file) {
-            // Write <num_of_values> random double values
-            for (int j=0; j<num_of_values; j++) {
-                std::random_device rd;            
-                std::mt19937 generator(rd());     // RNG
-                std::uniform_real_distribution<float> distr(-100000, 100000);
-                out_file << distr(generator) << " ";
+    for (long long num_of_values : opts.sizes) {
+        if (num_of_values <= static_cast<long long>(block_values)) {
+            continue;
+        }
+        for (long long file = 0; file < opts.num_of_files; file++) {
+            if (!generate_large_file(opts, pool, num_of_values, file,
+                zipf_cdf)) {
+                return 0;
             }
         }
+    }
+    return 1;
+}
 
-        else {
+int generate_file(const GeneratorOptions &opts, long long num_of_values,
+    long long file, const std::vector<double> &zipf_cdf) {
+    /**
+     * Generates one file of at most one block of values
+     *
+     * Parameters:
+     *  opts (GeneratorOptions)     :   distribution, format and seed
+     *  num_of_values (long long)   :   Number of random values to generate
+     *  file (long long)            :   Number of the file, from 0
+     *  zipf_cdf (vector<double>)   :   Table of the zipf distribution
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if successful, 0 if not
+     */
+
+    std::string p = file_path(opts, num_of_values, file);
+    std::vector<double> values(num_of_values);
+    fill_block(values.data(), values.size(), 0, num_of_values,
+        opts.distribution, derive_seed(derive_seed(derive_seed(opts.seed,
+        num_of_values), file), 0), zipf_cdf);
+
+    if (opts.format == FileFormat::binary) {
+        return write_binary_file(p, values.data(), values.size());
+    }
+
+    std::vector<char> text(values.size() * max_value_chars);
+    std::size_t size = format_block(values.data(), values.size(),
+        opts.distribution, text);
+    std::ofstream out_file(p, std::ios::binary);
+    if (!out_file) {
+        return 0;
+    }
+    out_file.write(text.data(), size);
+    out_file.close();
+    return !out_file.fail();
+}
+
+int generate_large_file(const GeneratorOptions &opts, ThreadPool &pool,
+    long long num_of_values, long long file,
+    const std::vector<double> &zipf_cdf) {
+    /**
+     * Generates one file with <num_of_values> random values in rounds of
+     *  one block per thread. The blocks of a round are generated and
+     *  formatted in parallel, then written in order
+     *
+     * Parameters:
+     *  opts (GeneratorOptions)     :   distribution, format and seed
+     *  pool (ThreadPool &)         :   threads that generate the blocks
+     *  num_of_values (long long)   :   Number of random values to generate
+     *  file (long long)            :   Number of the file, from 0
+     *  zipf_cdf (vector<double>)   :   Table of the zipf distribution
+     *
+     * Returns:
+     *  (int)   :   Returns 1 if successful, 0 if not
+     */
+
+    std::string p = file_path(opts, num_of_values, file);
+    std::uint64_t file_seed = derive_seed(derive_seed(opts.seed,
+        num_of_values), file);
+    const bool ascii = (opts.format == FileFormat::ascii);
+
+    std::unique_ptr<BinaryWriter<double>> binary_out;
+    std::ofstream out_file;
+    if (ascii) {
+        out_file.open(p, std::ios::binary);
+        if (!out_file) {
             return 0;
-        }            
+        }
     }
-    return 1;
-}
\ No newline at end of file
+    else {
+        binary_out = std::make_unique<BinaryWriter<double>>(p);
+    }
+
+    // One block of values and text per thread, reused every round
+    const long long num_of_blocks = (num_of_values + block_values - 1)
+        / block_values;
+    const std::size_t round = std::min<long long>(pool.size(), num_of_blocks);
+    std::vector<std::vector<double>> values(round,
+        std::vector<double>(block_values));
+    std::vector<std::vector<char>> text(ascii ? round : 0,
+        std::vector<char>(block_values * max_value_chars));
+    std::vector<std::size_t> text_size(round, 0);
+
+    for (long long first = 0; first < num_of_blocks; first += round) {
+        std::size_t blocks = std::min<long long>(round, num_of_blocks - first);
+        TaskGroup group;
+        for (std::size_t b = 0; b < blocks; b++) {
+            pool.run(group, [&, b, first]() {
+                long long block = first + b;
+                std::size_t n = std::min<long long>(block_values,
+                    num_of_values - block * block_values);
+                fill_block(values[b].data(), n, block * block_values,
+                    num_of_values, opts.distribution,
+                    derive_seed(file_seed, block), zipf_cdf);
+                if (ascii) {
+                    text_size[b] = format_block(values[b].data(), n,
+                        opts.distribution, text[b]);
+                }
+            });
+        }
+        pool.wait(group);
+
+        for (std::size_t b = 0; b < blocks; b++) {
+            long long block = first + b;
+            std::size_t n = std::min<long long>(block_values,
+                num_of_values - block * block_values);
+            if (ascii) {
+                out_file.write(text[b].data(), text_size[b]);
+            }
+            else {
+                binary_out->append(values[b].data(), n);
+            }
+        }
+    }
+
+    if (ascii) {
+        out_file.close();
+        return !out_file.fail();
+    }
+    return binary_out->finish();
+}
+
+std::string file_path(const GeneratorOptions &opts, long long num_of_values,
+    long long file) {
+    /**
+     * Returns:
+     *  (string)    :   path of a file, <dir>/<num_of_values>/input-file-i
+     *                  with a .txt or .bin extension
+     */
+    return opts.dir + "/" + std::to_string(num_of_values) + "/input-file-"
+        + std::to_string(file + 1)
+        + (opts.format == FileFormat::binary ? ".bin" : ".txt");
+}
+
+void fill_block(double *values, std::size_t n, long long first,
+    long long num_of_values, Distribution distribution, std::uint64_t seed,
+    const std::vector<double> &zipf_cdf) {
+    /**
+     * Draws the values of one block from its own stream
+     *
+     * Parameters:
+     *  values (double *)           :   set to the values of the block
+     *  n (size_t)                  :   Number of values in the block
+     *  first (long long)           :   position of the first value in the
+     *                                  file
+     *  num_of_values (long long)   :   Number of values in the file
+     *  distribution (Distribution) :   distribution of the values
+     *  seed (uint64_t)             :   seed of the stream of the block
+     *  zipf_cdf (vector<double>)   :   Table of the zipf distribution
+     */
+    WyRand rng(seed);
+    const double pi = 3.14159265358979323846;
+    for (std::size_t j = 0; j < n; j++) {
+        switch (distribution) {
+            case Distribution::uniform:
+                values[j] = static_cast<float>(-100000 + 200000 * rng.unit());
+                break;
+            case Distribution::normal:
+                // Box-Muller transform, 1 - unit() is never 0
+                values[j] = static_cast<float>(normal_deviation
+                    * std::sqrt(-2 * std::log(1 - rng.unit()))
+                    * std::cos(2 * pi * rng.unit()));
+                break;
+            case Distribution::zipf: {
+                // Rank whose cumulative probability first exceeds the draw
+                std::size_t rank = std::upper_bound(zipf_cdf.begin(),
+                    zipf_cdf.end(), rng.unit()) - zipf_cdf.begin();
+                values[j] = std::min(rank, zipf_ranks - 1) + 1;
+                break;
+            }
+            case Distribution::few_unique:
+                // 16 evenly spaced levels in [-100000, 100000)
+                values[j] = -100000 + 12500 * static_cast<int>(rng.bounded(16));
+                break;
+            case Distribution::killer:
+                values[j] = killer_value(first + j, num_of_values);
+                break;
+            default:
+                values[j] = static_cast<float>(ordered_value(first + j,
+                    num_of_values, distribution, rng.unit()));
+                break;
+        }
+    }
+}
+
+std::size_t format_block(const double *values, std::size_t n,
+    Distribution distribution, std::vector<char> &text) {
+    /**
+     * Writes values in their shortest round trip form, seperated by spaces
+     *
+     * Parameters:
+     *  values (const double *)     :   values to format
+     *  n (size_t)                  :   Number of values
+     *  distribution (Distribution) :   distribution of the values
+     *  text (vector<char> &)       :   room for n * max_value_chars chars
+     *
+     * Returns:
+     *  (size_t)    :   Number of chars written
+     */
+    char *t = text.data();
+    char *end = text.data() + text.size();
+    if (is_integer(distribution)) {
+        // Fixed notation, so integer key types can parse the values
+        for (std::size_t j = 0; j < n; j++) {
+            t = std::to_chars(t, end, values[j], std::chars_format::fixed).ptr;
+            *t++ = ' ';
+        }
+    }
+    else {
+        // Values are drawn as floats, so print them as floats
+        for (std::size_t j = 0; j < n; j++) {
+            t = std::to_chars(t, end, static_cast<float>(values[j])).ptr;
+            *t++ = ' ';
+        }
+    }
+    return t - text.data();
+}
+
+std::vector<double> zipf_table() {
+    /**
+     * Returns:
+     *  (vector<double>)    :   cumulative probability of the zipf ranks
+     *                          1 to zipf_ranks
+     */
+    std::vector<double> cdf(zipf_ranks);
+    double sum = 0;
+    for (std::size_t k = 0; k < zipf_ranks; k++) {
+        sum += std::pow(static_cast<double>(k + 1), -zipf_exponent);
+        cdf[k] = sum;
+    }
+    for (double &p : cdf) {
+        p /= sum;
+    }
+    return cdf;
+}
+
+bool is_integer(Distribution distribution) {
+    /**
+     * Returns:
+     *  (bool)  :   true for the zipf, few-unique and killer distributions,
+     *              whose values are integers
+     */
+    return distribution == Distribution::zipf
+        || distribution == Distribution::few_unique
+        || distribution == Distribution::killer;
+}
+
+bool is_ordered(Distribution distribution) {
+    /**
+     * Returns:
+     *  (bool)  :   true for the sorted, reverse, nearly-sorted and organ-pipe
+     *              distributions, whose values depend on their position
+     */
+    return distribution == Distribution::sorted
+        || distribution == Distribution::reverse
+        || distribution == Distribution::nearly_sorted
+        || distribution == Distribution::organ_pipe;
+}
+
+double ordered_value(long long index, long long num_of_values,
+    Distribution distribution, double offset) {
+    /**
+     * Finds the value at a position of an ordered distribution
+     * [-100000, 100000) is split into equal slices, one per value, and the
+     *  value is drawn from the slice of its rank
+     *
+     * Parameters:
+     *  index (long long)           :   position of the value in the file
+     *  num_of_values (long long)   :   number of values in the file
+     *  distribution (Distribution) :   sorted, reverse, nearly-sorted or
+     *                                  organ-pipe
+     *  offset (double)             :   random position in the slice, [0, 1)
+     *
+     * Returns:
+     *  (double)    :   the value at the given position
+     */
+
+    long long rank = index;
+    long long slices = num_of_values;
+    if (distribution == Distribution::reverse) {
+        rank = num_of_values - 1 - index;
+    }
+    else if (distribution == Distribution::nearly_sorted) {
+        // Every run covers the whole range
+        long long run_length = (num_of_values + nearly_sorted_runs - 1)
+            / nearly_sorted_runs;
+        rank = index % run_length;
+        slices = run_length;
+    }
+    else if (distribution == Distribution::organ_pipe) {
+        // Even ranks ascend to the middle, odd ranks descend from it
+        long long half = (num_of_values + 1) / 2;
+        rank = (index < half) ? 2 * index
+            : 2 * (num_of_values - 1 - index) + 1;
+    }
+    return -100000 + 200000 * (rank + offset) / slices;
+}
+
+double killer_value(long long index, long long num_of_values) {
+    /**
+     * Finds the value at a position of Musser's median-of-3 killer sequence
+     *  for k = num_of_values / 2, rounded down to an even number. The first
+     *  k positions hold 1, k+1, 3, k+3, ... and the next k positions the
+     *  even values 2, 4, ..., 2k, so the median-of-3 pivots keep splitting
+     *  off only two values. Positions after 2k count up
+     *
+     * Parameters:
+     *  index (long long)           :   position of the value in the file
+     *  num_of_values (long long)   :   number of values in the file
+     *
+     * Returns:
+     *  (double)    :   the value at the given position, 1 to num_of_values
+     */
+    long long k = num_of_values / 4 * 2;
+    if (index < k) {
+        return (index % 2 == 0) ? index + 1 : k + index;
+    }
+    if (index < 2 * k) {
+        return 2 * (index - k + 1);
+    }
+    return index + 1;
+}
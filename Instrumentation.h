@@ -0,0 +1,331 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     Instrumentation.h
+ *
+ * This header implements the counters that Azeem_Musa_QuickSort.cpp records
+ *   for every read, sort and write when it is built with
+ *   -DQUICKSORT_INSTRUMENT (make instrument=1)
+ *  - PerfCounters reads the hardware counters of a thread with
+ *    perf_event_open: cycles, instructions, branch misses and L1 data and
+ *    last level cache read misses. Every thread opens its events once.
+ *    Events the CPU, kernel or perf_event_paranoid do not allow are
+ *    reported as unavailable, and multiplexed events are scaled by the time
+ *    they were counted
+ *  - SortCounters counts comparisons, swaps, partitions, the deepest
+ *    partition level and the sizes of the larger sides of the partitions.
+ *    CountingCompare wraps the comparator so every comparison is counted
+ *  - CounterScope records both around a phase. Nested scopes on the same
+ *    counters leave the phase to the outermost one, and only the outermost
+ *    scope of a thread reads the hardware counters (a sorter nested in
+ *    another, like the one of an argsort, reports them as unavailable)
+ * Without QUICKSORT_INSTRUMENT only PhaseCounters is defined, and nothing is
+ *   counted
+ */
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef QUICKSORT_INSTRUMENT
+#include <atomic>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef QUICKSORT_INSTRUMENT
+constexpr bool instrument_enabled = true;
+#else
+constexpr bool instrument_enabled = false;
+#endif
+
+// Hardware events read around every phase
+enum PerfEvent {
+    perf_cycles, perf_instructions, perf_branch_misses, perf_l1d_misses,
+    perf_llc_misses, perf_event_count
+};
+
+// Column names of the hardware events in the execution time files
+constexpr const char *perf_event_names[perf_event_count] = {
+    "Cycles", "Instructions", "Branch Misses", "L1D Misses", "LLC Misses"
+};
+
+// Counters of one read, sort or write
+struct PhaseCounters {
+    std::array<double, perf_event_count> events{};
+    std::array<bool, perf_event_count> available{};
+    std::uint64_t comparisons = 0;
+    std::uint64_t swaps = 0;
+    std::uint64_t partitions = 0;
+    std::uint64_t max_depth = 0;    // deepest partition level
+    double imbalance = 0;           // larger sides / partitioned values
+};
+
+#ifdef QUICKSORT_INSTRUMENT
+
+struct SortCounters {
+    std::atomic<std::uint64_t> comparisons{0};
+    std::atomic<std::uint64_t> swaps{0};
+    std::atomic<std::uint64_t> partitions{0};
+    std::atomic<std::uint64_t> max_depth{0};
+    std::atomic<std::uint64_t> larger_sides{0};
+    std::atomic<std::uint64_t> partitioned{0};
+    int active = 0;                 // open scopes, owning thread only
+
+    void reset();
+    void record_partition(const std::uint64_t n, const std::uint64_t larger,
+        const std::uint64_t depth);
+    void snapshot(PhaseCounters &out) const;
+};
+
+inline void SortCounters::reset() {
+    /**
+     * Sets every counter to 0
+     */
+    comparisons = 0;
+    swaps = 0;
+    partitions = 0;
+    max_depth = 0;
+    larger_sides = 0;
+    partitioned = 0;
+}
+
+inline void SortCounters::record_partition(const std::uint64_t n,
+    const std::uint64_t larger, const std::uint64_t depth) {
+    /**
+     * Counts one partition. Threads of the parallel engine record theirs
+     *  concurrently, so every update is atomic
+     *
+     * Parameters:
+     *      n (uint64_t)        :   values in the partitioned subarray
+     *      larger (uint64_t)   :   values in its larger side
+     *      depth (uint64_t)    :   partition level of the subarray, from 1
+     */
+    partitions.fetch_add(1, std::memory_order_relaxed);
+    larger_sides.fetch_add(larger, std::memory_order_relaxed);
+    partitioned.fetch_add(n, std::memory_order_relaxed);
+    std::uint64_t seen = max_depth.load(std::memory_order_relaxed);
+    while (depth > seen && !max_depth.compare_exchange_weak(seen, depth,
+        std::memory_order_relaxed)) {
+    }
+}
+
+inline void SortCounters::snapshot(PhaseCounters &out) const {
+    /**
+     * Parameters:
+     *      out (PhaseCounters &)   :   set to the algorithmic counters
+     */
+    out.comparisons = comparisons.load(std::memory_order_relaxed);
+    out.swaps = swaps.load(std::memory_order_relaxed);
+    out.partitions = partitions.load(std::memory_order_relaxed);
+    out.max_depth = max_depth.load(std::memory_order_relaxed);
+    std::uint64_t n = partitioned.load(std::memory_order_relaxed);
+    out.imbalance = (n == 0) ? 0
+        : static_cast<double>(larger_sides.load(std::memory_order_relaxed))
+            / n;
+}
+
+template <typename Compare>
+struct CountingCompare : Compare {
+    /**
+     * Comparator that counts its calls and otherwise behaves like Compare.
+     *  It converts to Compare, so it can be passed where one is expected
+     */
+    std::atomic<std::uint64_t> *count;
+
+    CountingCompare(const Compare &comp, std::atomic<std::uint64_t> *count)
+        : Compare(comp), count(count) {}
+
+    template <typename A, typename B>
+    bool operator()(const A &a, const B &b) const {
+        count->fetch_add(1, std::memory_order_relaxed);
+        return Compare::operator()(a, b);
+    }
+};
+
+class PerfCounters {
+
+    private:
+        std::array<int, perf_event_count> fds;
+        bool opened = false;
+
+        void open_events();
+
+    public:
+        PerfCounters();
+        ~PerfCounters();
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        static PerfCounters &for_thread();
+        void start();
+        void stop(PhaseCounters &out);
+};
+
+inline PerfCounters::PerfCounters() {
+    /**
+     * Events are opened by the first start, on the thread that counts
+     */
+    fds.fill(-1);
+}
+
+inline PerfCounters::~PerfCounters() {
+    /**
+     * Closes the events
+     */
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+inline PerfCounters &PerfCounters::for_thread() {
+    /**
+     * Returns:
+     *      (PerfCounters &)    :   the events of the calling thread
+     */
+    static thread_local PerfCounters perf;
+    return perf;
+}
+
+inline void PerfCounters::open_events() {
+    /**
+     * Opens one disabled event per hardware counter for the calling thread,
+     *  in user space only. Events that cannot be opened stay at -1
+     */
+    const std::uint64_t read_miss = PERF_COUNT_HW_CACHE_OP_READ << 8
+        | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    const std::uint32_t types[perf_event_count] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+    };
+    const std::uint64_t configs[perf_event_count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_L1D | read_miss,
+        PERF_COUNT_HW_CACHE_LL | read_miss
+    };
+    for (int e = 0; e < perf_event_count; e++) {
+        struct perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = types[e];
+        attr.config = configs[e];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+            -1, PERF_FLAG_FD_CLOEXEC));
+    }
+    opened = true;
+}
+
+inline void PerfCounters::start() {
+    /**
+     * Resets and starts every available event
+     */
+    if (!opened) {
+        open_events();
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+inline void PerfCounters::stop(PhaseCounters &out) {
+    /**
+     * Stops the events and reads them
+     *
+     * Parameters:
+     *      out (PhaseCounters &)   :   set to the value of every event,
+     *                                  scaled up if it was multiplexed
+     */
+    for (int e = 0; e < perf_event_count; e++) {
+        out.events[e] = 0;
+        out.available[e] = false;
+        if (fds[e] < 0) {
+            continue;
+        }
+        ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        std::uint64_t value[3];     // count, time enabled, time running
+        if (read(fds[e], value, sizeof(value)) != sizeof(value)
+            || value[2] == 0) {
+            continue;
+        }
+        out.events[e] = static_cast<double>(value[0])
+            * (static_cast<double>(value[1]) / value[2]);
+        out.available[e] = true;
+    }
+}
+
+class CounterScope {
+    /**
+     * Records the counters of a phase from its construction to its
+     *  destruction into a PhaseCounters
+     */
+
+    private:
+        SortCounters &counters;
+        PhaseCounters &out;
+        bool records = false;       // outermost scope on the counters
+        bool reads_perf = false;    // outermost scope of the thread
+
+        // Scopes of the calling thread that read the hardware counters
+        static inline thread_local int perf_scopes = 0;
+
+    public:
+        CounterScope(SortCounters &counters, PhaseCounters &out);
+        ~CounterScope();
+        CounterScope(const CounterScope &) = delete;
+        CounterScope &operator=(const CounterScope &) = delete;
+};
+
+inline CounterScope::CounterScope(SortCounters &counters, PhaseCounters &out)
+    : counters(counters), out(out) {
+    /**
+     * Resets the counters and starts the events, unless a scope on the
+     *  same counters is already open
+     */
+    if (counters.active++ > 0) {
+        return;
+    }
+    records = true;
+    counters.reset();
+    reads_perf = (perf_scopes++ == 0);
+    if (reads_perf) {
+        PerfCounters::for_thread().start();
+    }
+}
+
+inline CounterScope::~CounterScope() {
+    /**
+     * Stops the events and stores the counters when the outermost scope
+     *  closes
+     */
+    counters.active--;
+    if (!records) {
+        return;
+    }
+    perf_scopes--;
+    if (reads_perf) {
+        PerfCounters::for_thread().stop(out);
+    }
+    else {
+        out.events.fill(0);
+        out.available.fill(false);
+    }
+    counters.snapshot(out);
+}
+
+#endif  // QUICKSORT_INSTRUMENT
+
+#endif  // INSTRUMENTATION_H
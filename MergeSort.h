@@ -0,0 +1,228 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     MergeSort.h
+ *
+ * This header implements the stable merge sort used by the "merge" engine
+ *   of the QuickSort class in Azeem_Musa_QuickSort.cpp
+ *  - The input is split into one chunk per thread. Each thread sorts its
+ *    chunk with insertion sorted runs that are merged bottom up
+ *  - The sorted chunks are merged in pairs, one round per level. Every
+ *    round splits its output into equal segments with merge path
+ *    (co-ranking), so each thread merges the same number of values however
+ *    the values of the two runs interleave
+ *  - Every merge moves the values between the input and one buffer of the
+ *    same size, so the sort allocates nothing
+ *  - Values that compare equal keep their input order: runs are always
+ *    merged left before right, and ties are taken from the left run
+ */
+
+#ifndef MERGE_SORT_H
+#define MERGE_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+// Values per insertion sorted run of a chunk
+constexpr std::size_t merge_run_size = 32;
+// Fewest values per thread before the sort is split across threads
+constexpr std::size_t merge_parallel_grain = 1 << 14;
+
+template <typename T, typename Compare>
+std::size_t merge_co_rank(const T *a, const std::size_t m, const T *b,
+    const std::size_t n, const std::size_t k, Compare comp) {
+    /**
+     * Finds how many values of each run come before position k of their
+     *  stable merge (merge path). Values of "a" win ties
+     *
+     * Parameters:
+     *      a (T *)         :   left sorted run
+     *      m (size_t)      :   values in a
+     *      b (T *)         :   right sorted run
+     *      n (size_t)      :   values in b
+     *      k (size_t)      :   position in the merged output, at most m+n
+     *      comp (Compare)  :   order of the values
+     *
+     * Returns:
+     *      size_t  :   values of a among the first k merged values, the
+     *                  other k minus that many come from b
+     */
+    std::size_t lo = (k > n) ? k - n : 0;
+    std::size_t hi = std::min(k, m);
+    while (lo < hi) {
+        std::size_t i = lo + (hi - lo) / 2;
+        std::size_t j = k - i;
+        // a[i] is not after b[j-1], so it is merged before position k
+        if (j > 0 && !comp(b[j-1], a[i])) {
+            lo = i + 1;
+        }
+        else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+template <typename T, typename Compare>
+void merge_runs_into(T *a, const std::size_t m, T *b, const std::size_t n,
+    T *out, Compare comp) {
+    /**
+     * Moves the stable merge of two sorted runs into out
+     *
+     * Parameters:
+     *      a (T *)         :   left sorted run
+     *      m (size_t)      :   values in a
+     *      b (T *)         :   right sorted run
+     *      n (size_t)      :   values in b
+     *      out (T *)       :   room for m+n values, apart from both runs
+     *      comp (Compare)  :   order of the values
+     */
+    std::merge(std::make_move_iterator(a), std::make_move_iterator(a + m),
+        std::make_move_iterator(b), std::make_move_iterator(b + n), out,
+        comp);
+}
+
+template <typename T, typename Compare>
+void merge_sort_chunk(T *data, T *buffer, const std::size_t n,
+    const bool into_buffer, Compare comp) {
+    /**
+     * Sorts data[0..n-1] stably with bottom up merges between data and
+     *  buffer
+     *
+     * Parameters:
+     *      data (T *)          :   values to sort
+     *      buffer (T *)        :   scratch space for n values
+     *      n (size_t)          :   number of values
+     *      into_buffer (bool)  :   leave the sorted values in buffer instead
+     *                              of data
+     *      comp (Compare)      :   order of the values
+     */
+
+    // Insertion sort every run, shifting only past strictly greater values
+    for (std::size_t l = 0; l < n; l += merge_run_size) {
+        std::size_t r = std::min(n, l + merge_run_size);
+        for (std::size_t i = l + 1; i < r; i++) {
+            if (!comp(data[i], data[i-1])) {
+                continue;
+            }
+            T value = std::move(data[i]);
+            std::size_t j = i;
+            do {
+                data[j] = std::move(data[j-1]);
+                j--;
+            } while (j > l && comp(value, data[j-1]));
+            data[j] = std::move(value);
+        }
+    }
+
+    T *src = data;
+    T *dst = buffer;
+    for (std::size_t width = merge_run_size; width < n; width *= 2) {
+        for (std::size_t l = 0; l < n; l += 2 * width) {
+            std::size_t mid = std::min(n, l + width);
+            std::size_t r = std::min(n, l + 2 * width);
+            merge_runs_into(src + l, mid - l, src + mid, r - mid, dst + l,
+                comp);
+        }
+        std::swap(src, dst);
+    }
+
+    // The number of passes left the values on the other side
+    T *target = into_buffer ? buffer : data;
+    if (src != target) {
+        std::move(src, src + n, target);
+    }
+}
+
+template <typename T, typename Compare>
+void parallel_merge_sort(T *data, const std::size_t n, T *buffer,
+    Compare comp, ThreadPool *pool) {
+    /**
+     * Sorts data[0..n-1] stably on the threads of a pool
+     *
+     * Parameters:
+     *      data (T *)          :   values to sort
+     *      n (size_t)          :   number of values
+     *      buffer (T *)        :   scratch space for n values
+     *      comp (Compare)      :   order of the values
+     *      pool (ThreadPool *) :   threads to sort on, or nullptr to sort on
+     *                              the calling thread only
+     */
+    if (n < 2) {
+        return;
+    }
+    std::size_t threads = (pool == nullptr) ? 1 : pool->size();
+    std::size_t chunks = std::max<std::size_t>(1,
+        std::min(threads, n / merge_parallel_grain));
+    if (chunks == 1) {
+        merge_sort_chunk(data, buffer, n, false, comp);
+        return;
+    }
+
+    // Chunks end on the side that leaves the last merge round in data
+    std::size_t rounds = 0;
+    while ((std::size_t(1) << rounds) < chunks) {
+        rounds++;
+    }
+    const bool into_buffer = rounds % 2 == 1;
+    std::vector<std::size_t> bounds(chunks + 1);
+    for (std::size_t c = 0; c <= chunks; c++) {
+        bounds[c] = n * c / chunks;
+    }
+    TaskGroup sort_group;
+    for (std::size_t c = 0; c < chunks; c++) {
+        pool->run(sort_group, [&, c]() {
+            merge_sort_chunk(data + bounds[c], buffer + bounds[c],
+                bounds[c+1] - bounds[c], into_buffer, comp);
+        });
+    }
+    pool->wait(sort_group);
+
+    // Merge neighbouring runs in rounds. Each round is split into segments
+    //  of about n / threads merged values
+    T *src = into_buffer ? buffer : data;
+    T *dst = into_buffer ? data : buffer;
+    const std::size_t segment = (n + threads - 1) / threads;
+    while (bounds.size() > 2) {
+        std::vector<std::size_t> merged;
+        TaskGroup merge_group;
+        std::size_t r = 0;
+        for (; r + 2 < bounds.size(); r += 2) {
+            merged.push_back(bounds[r]);
+            T *a = src + bounds[r];
+            T *b = src + bounds[r+1];
+            T *out = dst + bounds[r];
+            const std::size_t m = bounds[r+1] - bounds[r];
+            const std::size_t len = bounds[r+2] - bounds[r+1];
+            for (std::size_t k = 0; k < m + len; k += segment) {
+                pool->run(merge_group, [=]() {
+                    std::size_t end = std::min(m + len, k + segment);
+                    std::size_t i = merge_co_rank(a, m, b, len, k, comp);
+                    std::size_t i_end = merge_co_rank(a, m, b, len, end,
+                        comp);
+                    merge_runs_into(a + i, i_end - i, b + (k - i),
+                        (end - i_end) - (k - i), out + k, comp);
+                });
+            }
+        }
+        if (r + 1 < bounds.size()) {
+            // Odd run out, moved to keep every run on the same side
+            merged.push_back(bounds[r]);
+            std::size_t first = bounds[r];
+            std::size_t last = bounds[r+1];
+            pool->run(merge_group, [=]() {
+                std::move(src + first, src + last, dst + first);
+            });
+        }
+        merged.push_back(n);
+        pool->wait(merge_group);
+        bounds = std::move(merged);
+        std::swap(src, dst);
+    }
+}
+
+#endif  // MERGE_SORT_H
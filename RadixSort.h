@@ -0,0 +1,156 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     RadixSort.h
+ *
+ * This header implements the least significant digit radix sort used by the
+ *   "radix" engine of the QuickSort class in Azeem_Musa_QuickSort.cpp
+ *  - Keys are mapped to unsigned integers that compare like the keys: the
+ *    sign bit of signed integers is flipped, and floats flip the sign bit
+ *    when positive or every bit when negative
+ *  - The histograms of every digit are counted in one pass over the input
+ *  - A digit that is the same for every key needs no pass and is skipped
+ *  - Each pass scatters the values between the input and a buffer of the
+ *    same size, so a sort takes one pass per digit plus the counting pass
+ *
+ * Supported key types: double, float, int64_t, uint64_t, int32_t and uint32_t
+ */
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Key types the radix engine can sort
+template <typename T>
+constexpr bool radix_key_v = std::is_same_v<T, double>
+    || std::is_same_v<T, float> || std::is_same_v<T, std::int64_t>
+    || std::is_same_v<T, std::uint64_t> || std::is_same_v<T, std::int32_t>
+    || std::is_same_v<T, std::uint32_t>;
+
+// Unsigned integer holding the radix key of T
+template <typename T>
+using radix_bits_t = std::conditional_t<sizeof(T) == 8,
+    std::uint64_t, std::uint32_t>;
+
+template <typename T>
+inline radix_bits_t<T> radix_key(const T value) {
+    /**
+     * Maps a value to an unsigned key in the same order (for floats, -0.0
+     *  comes before 0.0 and NaNs go to the ends by their sign bit)
+     *
+     * Parameters:
+     *      value (T)   :   value to map
+     *
+     * Returns:
+     *      radix_bits_t<T> :   unsigned key of the value
+     */
+    using U = radix_bits_t<T>;
+    constexpr U sign_bit = U(1) << (8 * sizeof(T) - 1);
+    U bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    if constexpr (std::is_floating_point_v<T>) {
+        U negative = bits >> (8 * sizeof(T) - 1);
+        return bits ^ ((U(0) - negative) | sign_bit);
+    }
+    else if constexpr (std::is_signed_v<T>) {
+        return bits ^ sign_bit;
+    }
+    else {
+        return bits;
+    }
+}
+
+template <unsigned DigitBits, typename T>
+void radix_sort(T *data, const std::size_t n, T *buffer) {
+    /**
+     * Sorts data[0..n-1] in ascending order with DigitBits bits per pass
+     *
+     * Template Parameters:
+     *  DigitBits   :   bits per digit (8 or 11)
+     *
+     * Parameters:
+     *      data (T *)      :   values to sort
+     *      n (size_t)      :   number of values
+     *      buffer (T *)    :   scratch space for n values
+     */
+    using U = radix_bits_t<T>;
+    constexpr unsigned passes = (8 * sizeof(T) + DigitBits - 1) / DigitBits;
+    constexpr std::size_t buckets = std::size_t(1) << DigitBits;
+    constexpr U mask = buckets - 1;
+    if (n < 2) {
+        return;
+    }
+
+    // Count every digit in one pass
+    std::vector<std::size_t> counts(passes * buckets, 0);
+    for (std::size_t i = 0; i < n; i++) {
+        U key = radix_key(data[i]);
+        for (unsigned p = 0; p < passes; p++) {
+            counts[p * buckets + ((key >> (p * DigitBits)) & mask)]++;
+        }
+    }
+
+    T *src = data;
+    T *dst = buffer;
+    for (unsigned p = 0; p < passes; p++) {
+        const unsigned shift = p * DigitBits;
+        std::size_t *offsets = &counts[p * buckets];
+        // Every key has the same digit, the pass would not move anything
+        if (offsets[(radix_key(src[0]) >> shift) & mask] == n) {
+            continue;
+        }
+
+        // Exclusive prefix sum turns the counts into bucket offsets
+        std::size_t sum = 0;
+        for (std::size_t b = 0; b < buckets; b++) {
+            std::size_t count = offsets[b];
+            offsets[b] = sum;
+            sum += count;
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            dst[offsets[(radix_key(src[i]) >> shift) & mask]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    // An odd number of passes leaves the result in the buffer
+    if (src != data) {
+        std::copy(src, src + n, data);
+    }
+}
+
+inline bool radix_digit_bits_valid(const unsigned digit_bits) {
+    /**
+     * Returns:
+     *      bool    :   true if radix_sort_bits supports the digit width
+     */
+    return digit_bits == 8 || digit_bits == 11;
+}
+
+template <typename T>
+void radix_sort_bits(T *data, const std::size_t n, T *buffer,
+    const unsigned digit_bits) {
+    /**
+     * Sorts data[0..n-1] with a digit width chosen at runtime
+     *
+     * Parameters:
+     *      data (T *)              :   values to sort
+     *      n (size_t)              :   number of values
+     *      buffer (T *)            :   scratch space for n values
+     *      digit_bits (unsigned)   :   8 or 11 bits per pass
+     */
+    if (digit_bits == 8) {
+        radix_sort<8>(data, n, buffer);
+    }
+    else {
+        radix_sort<11>(data, n, buffer);
+    }
+}
+
+#endif  // RADIX_SORT_H
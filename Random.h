@@ -0,0 +1,133 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     Random.h
+ *
+ * This header implements the pseudo random number generator used to pick
+ *   pivots in Azeem_Musa_QuickSort.cpp and to draw values in
+ *   InputFileGenerator.cpp
+ *  - WyRand is a counter based generator: its state is a 64-bit counter
+ *    that is mixed with one 64x64->128-bit multiply per value. It has no
+ *    locks or shared state, so every sorter and thread owns its own
+ *  - bounded draws an unbiased integer below a bound with Lemire's
+ *    multiply-shift reduction, which needs no division in almost every draw
+ *  - Generators are seeded explicitly, so a seed replays the same sequence.
+ *    derive_seed splits one seed into independent streams
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+class WyRand {
+
+    private:
+        std::uint64_t state;
+
+        static constexpr std::uint64_t increment = 0xa0761d6478bd642fULL;
+        static constexpr std::uint64_t mix = 0xe7037ed1a0b428dbULL;
+
+    public:
+        explicit WyRand(const std::uint64_t seed = 0);
+        void seed(const std::uint64_t seed);
+        std::uint64_t next();
+        std::uint64_t bounded(const std::uint64_t bound);
+        double unit();
+};
+
+inline WyRand::WyRand(const std::uint64_t seed) : state(seed) {
+    /**
+     * Parameters:
+     *      seed (uint64_t) :   start of the sequence
+     */
+}
+
+inline void WyRand::seed(const std::uint64_t seed) {
+    /**
+     * Restarts the sequence of the given seed
+     *
+     * Parameters:
+     *      seed (uint64_t) :   start of the sequence
+     */
+    state = seed;
+}
+
+inline std::uint64_t WyRand::next() {
+    /**
+     * Returns:
+     *      uint64_t    :   next value of the sequence
+     */
+    state += increment;
+    __uint128_t product = static_cast<__uint128_t>(state) * (state ^ mix);
+    return static_cast<std::uint64_t>(product >> 64)
+        ^ static_cast<std::uint64_t>(product);
+}
+
+inline std::uint64_t WyRand::bounded(const std::uint64_t bound) {
+    /**
+     * Draws a value in [0, bound) without modulo bias. The high half of
+     *  next() * bound is the value; draws whose low half falls in the
+     *  (2^64 mod bound) values that would be overrepresented are repeated
+     *
+     * Parameters:
+     *      bound (uint64_t)    :   number of possible values, at least 1
+     *
+     * Returns:
+     *      uint64_t    :   random value below bound
+     */
+    __uint128_t product = static_cast<__uint128_t>(next()) * bound;
+    std::uint64_t low = static_cast<std::uint64_t>(product);
+    if (low < bound) {
+        // 2^64 mod bound, computed only when a draw may be rejected
+        std::uint64_t threshold = (0 - bound) % bound;
+        while (low < threshold) {
+            product = static_cast<__uint128_t>(next()) * bound;
+            low = static_cast<std::uint64_t>(product);
+        }
+    }
+    return static_cast<std::uint64_t>(product >> 64);
+}
+
+inline double WyRand::unit() {
+    /**
+     * Returns:
+     *      double  :   uniform value in [0, 1) with 53 random bits
+     */
+    return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline std::uint64_t derive_seed(const std::uint64_t seed,
+    const std::uint64_t stream) {
+    /**
+     * Mixes a seed and a stream number with the splitmix64 finalizer, so
+     *  neighbouring streams start far apart in the sequence
+     *
+     * Parameters:
+     *      seed (uint64_t)     :   seed of the run
+     *      stream (uint64_t)   :   number of the stream
+     *
+     * Returns:
+     *      uint64_t    :   seed of the stream
+     */
+    std::uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+inline std::uint64_t random_seed() {
+    /**
+     * Returns:
+     *      uint64_t    :   a seed for runs that did not choose one, mixed
+     *                      from the random device and the clock
+     */
+    std::random_device rd;
+    std::uint64_t seed = (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+    return seed ^ static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+#endif  // RANDOM_H
@@ -0,0 +1,596 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     SimdPartition.h
+ *
+ * This header implements the x86 SIMD kernels used by the "simd" engine of
+ *   the QuickSort class in Azeem_Musa_QuickSort.cpp
+ *  - Partitions an array around a pivot with AVX-512 compress-stores, or with
+ *    AVX2 permutes driven by a lookup table of lane orders
+ *  - Sorts small leaves with a branchless bitonic sorting network compiled
+ *    for the selected instruction set, so its layers can be vectorized
+ *  - Selects the widest instruction set the CPU supports at runtime, so one
+ *    binary runs on every x86 machine and falls back to scalar code elsewhere
+ *
+ * Supported key types: double, float, int64_t, int32_t and uint32_t
+ */
+
+#ifndef SIMD_PARTITION_H
+#define SIMD_PARTITION_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_PARTITION_X86 1
+#include <immintrin.h>
+#endif
+
+// Instruction sets the simd engine can use, from narrowest to widest
+enum class SimdLevel { scalar, avx2, avx512 };
+
+// Key types that have SIMD kernels
+template <typename T>
+constexpr bool simd_key_v = std::is_same_v<T, double>
+    || std::is_same_v<T, float> || std::is_same_v<T, std::int64_t>
+    || std::is_same_v<T, std::int32_t> || std::is_same_v<T, std::uint32_t>;
+
+inline SimdLevel detect_simd_level() {
+    /**
+     * Finds the widest instruction set supported by the CPU
+     * The result is computed once and cached
+     *
+     * Returns:
+     *      SimdLevel   :   avx512, avx2 or scalar
+     */
+#ifdef SIMD_PARTITION_X86
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return SimdLevel::avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return SimdLevel::avx2;
+        }
+        return SimdLevel::scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::scalar;
+#endif
+}
+
+inline std::string simd_level_name(const SimdLevel level) {
+    /**
+     * Returns:
+     *      string  :   name of the instruction set as accepted by --simd
+     */
+    switch (level) {
+        case SimdLevel::avx512: return "avx512";
+        case SimdLevel::avx2:   return "avx2";
+        default:                return "scalar";
+    }
+}
+
+template <typename T>
+constexpr T network_padding() {
+    /**
+     * Returns:
+     *      T   :   value that sorts after every key, used to pad leaves to
+     *              the size of the sorting network
+     */
+    if constexpr (std::numeric_limits<T>::has_infinity) {
+        return std::numeric_limits<T>::infinity();
+    }
+    else {
+        return std::numeric_limits<T>::max();
+    }
+}
+
+template <typename T>
+inline void compare_exchange(T &a, T &b) {
+    /**
+     * Orders a pair of values branchlessly. The values are exchanged only 
+     *  when b < a, so both are kept bit for bit: std::min/std::max would
+     *  return the same operand twice for -0.0 and 0.0
+     */
+    const bool exchange = b < a;
+    const T lo = exchange ? b : a;
+    const T hi = exchange ? a : b;
+    a = lo;
+    b = hi;
+}
+
+template <typename T, int N, int D>
+inline void bitonic_half_cleaner(T *v) {
+    /**
+     * Compares each value with the value D places after it in every block of
+     *  2*D values, for D, D/2, ..., 1
+     */
+    for (int b = 0; b < N; b += 2*D) {
+        for (int i = 0; i < D; i++) {
+            compare_exchange(v[b+i], v[b+i+D]);
+        }
+    }
+    if constexpr (D > 1) {
+        bitonic_half_cleaner<T, N, D/2>(v);
+    }
+}
+
+template <typename T, int N, int K = 2>
+inline void bitonic_network(T *v) {
+    /**
+     * Sorts the N (power of 2) values of v with a bitonic sorting network
+     * Every compare-exchange is a branchless select and all loop bounds are
+     *  compile time constants, so layers can be vectorized
+     */
+
+    // Compare each value of a block of size K with its mirror image
+    for (int b = 0; b < N; b += K) {
+        for (int i = 0; i < K/2; i++) {
+            compare_exchange(v[b+i], v[b+K-1-i]);
+        }
+    }
+    if constexpr (K >= 4) {
+        bitonic_half_cleaner<T, N, K/4>(v);
+    }
+    if constexpr (K < N) {
+        bitonic_network<T, N, 2*K>(v);
+    }
+}
+
+template <typename T, typename Index>
+inline bool network_sort_leaf(T *a, const Index n) {
+    /**
+     * Sorts a leaf of at most 32 values by padding it to the next sorting
+     *  network size. NaNs are unordered, so a network could leave them
+     *  among the padding: leaves holding one are left to the caller
+     *
+     * Parameters:
+     *      a (T *)     :   values to sort
+     *      n (Index)   :   number of values (n <= 32)
+     *
+     * Returns:
+     *      bool    :   true if the leaf was sorted, false if it holds a NaN
+     *                  and was left unchanged
+     */
+    if constexpr (std::is_floating_point_v<T>) {
+        bool nan = false;
+        for (Index i = 0; i < n; i++) {
+            nan |= (a[i] != a[i]);
+        }
+        if (nan) {
+            return false;
+        }
+    }
+    alignas(64) T buf[32];
+    const int size = (n <= 16) ? 16 : 32;
+    for (int i = 0; i < size; i++) {
+        buf[i] = (i < n) ? a[i] : network_padding<T>();
+    }
+    if (size == 16) {
+        bitonic_network<T, 16>(buf);
+    }
+    else {
+        bitonic_network<T, 32>(buf);
+    }
+    for (Index i = 0; i < n; i++) {
+        a[i] = buf[i];
+    }
+    return true;
+}
+
+#ifdef SIMD_PARTITION_X86
+
+// Vector values live in functions without a target attribute until they are
+//  flattened into the AVX2/AVX-512 entry points below
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+template <int Lanes>
+struct LaneOrderTable {
+    /**
+     * AVX2 lookup table of 32-bit lane indices, one row per comparison mask,
+     *  that moves lanes whose mask bit is set to the front and the other
+     *  lanes to the back, both in their original order
+     * 64-bit lanes are expressed as pairs of 32-bit lanes
+     */
+    alignas(32) std::uint32_t rows[1 << Lanes][8];
+
+    constexpr LaneOrderTable() : rows() {
+        const int width = 8 / Lanes;    // 32-bit lanes per key
+        for (int mask = 0; mask < (1 << Lanes); mask++) {
+            int k = 0;
+            for (int pass = 0; pass < 2; pass++) {
+                for (int lane = 0; lane < Lanes; lane++) {
+                    bool set = (mask >> lane) & 1;
+                    if (set == (pass == 0)) {
+                        for (int w = 0; w < width; w++) {
+                            rows[mask][k++] = lane*width + w;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+inline constexpr LaneOrderTable<8> lane_order_32 = LaneOrderTable<8>();
+inline constexpr LaneOrderTable<4> lane_order_64 = LaneOrderTable<4>();
+
+template <typename T> struct Avx2Kernel;
+template <typename T> struct Avx512Kernel;
+
+/**
+ * Each kernel provides
+ *  - lanes             :   number of keys per vector
+ *  - load/store/set1   :   unaligned vector load/store and broadcast
+ *  - store_partitioned :   writes the keys of v less than the pivot to
+ *                          left[0..nlt) and the others to right_end[nlt-lanes..0)
+ *                          and returns nlt. The caller guarantees lanes free
+ *                          slots at both destinations
+ */
+
+template <>
+struct Avx2Kernel<double> {
+    using vec = __m256d;
+    static constexpr int lanes = 4;
+    __attribute__((target("avx2"))) static vec load(const double *p) {
+        return _mm256_loadu_pd(p);
+    }
+    __attribute__((target("avx2"))) static void store(double *p, vec v) {
+        _mm256_storeu_pd(p, v);
+    }
+    __attribute__((target("avx2"))) static vec set1(double x) {
+        return _mm256_set1_pd(x);
+    }
+    __attribute__((target("avx2,popcnt"))) static int store_partitioned(
+        double *left, double *right_end, vec v, vec p) {
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(v, p, _CMP_LT_OQ));
+        __m256i order = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(lane_order_64.rows[mask]));
+        vec out = _mm256_castsi256_pd(_mm256_permutevar8x32_epi32(
+            _mm256_castpd_si256(v), order));
+        _mm256_storeu_pd(left, out);
+        _mm256_storeu_pd(right_end - lanes, out);
+        return _mm_popcnt_u32(mask);
+    }
+};
+
+template <>
+struct Avx2Kernel<float> {
+    using vec = __m256;
+    static constexpr int lanes = 8;
+    __attribute__((target("avx2"))) static vec load(const float *p) {
+        return _mm256_loadu_ps(p);
+    }
+    __attribute__((target("avx2"))) static void store(float *p, vec v) {
+        _mm256_storeu_ps(p, v);
+    }
+    __attribute__((target("avx2"))) static vec set1(float x) {
+        return _mm256_set1_ps(x);
+    }
+    __attribute__((target("avx2,popcnt"))) static int store_partitioned(
+        float *left, float *right_end, vec v, vec p) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, p, _CMP_LT_OQ));
+        __m256i order = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(lane_order_32.rows[mask]));
+        vec out = _mm256_permutevar8x32_ps(v, order);
+        _mm256_storeu_ps(left, out);
+        _mm256_storeu_ps(right_end - lanes, out);
+        return _mm_popcnt_u32(mask);
+    }
+};
+
+template <typename T>
+struct Avx2IntKernel {
+    /**
+     * Shared AVX2 kernel for 32 and 64-bit integer keys
+     * Unsigned keys are compared as signed after flipping their sign bit
+     */
+    using vec = __m256i;
+    static constexpr int lanes = 32 / sizeof(T);
+    __attribute__((target("avx2"))) static vec load(const T *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    __attribute__((target("avx2"))) static void store(T *p, vec v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    __attribute__((target("avx2"))) static vec set1(T x) {
+        if constexpr (sizeof(T) == 8) {
+            return _mm256_set1_epi64x(x);
+        }
+        else {
+            return _mm256_set1_epi32(static_cast<std::int32_t>(x));
+        }
+    }
+    __attribute__((target("avx2,popcnt"))) static int store_partitioned(
+        T *left, T *right_end, vec v, vec p) {
+        int mask;
+        __m256i order;
+        if constexpr (sizeof(T) == 8) {
+            __m256i lt = _mm256_cmpgt_epi64(p, v);
+            mask = _mm256_movemask_pd(_mm256_castsi256_pd(lt));
+            order = _mm256_load_si256(
+                reinterpret_cast<const __m256i *>(lane_order_64.rows[mask]));
+        }
+        else {
+            __m256i lt;
+            if constexpr (std::is_unsigned_v<T>) {
+                const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+                lt = _mm256_cmpgt_epi32(_mm256_xor_si256(p, sign),
+                    _mm256_xor_si256(v, sign));
+            }
+            else {
+                lt = _mm256_cmpgt_epi32(p, v);
+            }
+            mask = _mm256_movemask_ps(_mm256_castsi256_ps(lt));
+            order = _mm256_load_si256(
+                reinterpret_cast<const __m256i *>(lane_order_32.rows[mask]));
+        }
+        vec out = _mm256_permutevar8x32_epi32(v, order);
+        store(left, out);
+        store(right_end - lanes, out);
+        return _mm_popcnt_u32(mask);
+    }
+};
+
+template <> struct Avx2Kernel<std::int64_t> : Avx2IntKernel<std::int64_t> {};
+template <> struct Avx2Kernel<std::int32_t> : Avx2IntKernel<std::int32_t> {};
+template <> struct Avx2Kernel<std::uint32_t> : Avx2IntKernel<std::uint32_t> {};
+
+template <>
+struct Avx512Kernel<double> {
+    using vec = __m512d;
+    static constexpr int lanes = 8;
+    __attribute__((target("avx512f"))) static vec load(const double *p) {
+        return _mm512_loadu_pd(p);
+    }
+    __attribute__((target("avx512f"))) static void store(double *p, vec v) {
+        _mm512_storeu_pd(p, v);
+    }
+    __attribute__((target("avx512f"))) static vec set1(double x) {
+        return _mm512_set1_pd(x);
+    }
+    __attribute__((target("avx512f,popcnt"))) static int store_partitioned(
+        double *left, double *right_end, vec v, vec p) {
+        __mmask8 mask = _mm512_cmp_pd_mask(v, p, _CMP_LT_OQ);
+        int nlt = _mm_popcnt_u32(mask);
+        _mm512_mask_compressstoreu_pd(left, mask, v);
+        _mm512_mask_compressstoreu_pd(right_end - (lanes - nlt),
+            static_cast<__mmask8>(~mask), v);
+        return nlt;
+    }
+};
+
+template <>
+struct Avx512Kernel<float> {
+    using vec = __m512;
+    static constexpr int lanes = 16;
+    __attribute__((target("avx512f"))) static vec load(const float *p) {
+        return _mm512_loadu_ps(p);
+    }
+    __attribute__((target("avx512f"))) static void store(float *p, vec v) {
+        _mm512_storeu_ps(p, v);
+    }
+    __attribute__((target("avx512f"))) static vec set1(float x) {
+        return _mm512_set1_ps(x);
+    }
+    __attribute__((target("avx512f,popcnt"))) static int store_partitioned(
+        float *left, float *right_end, vec v, vec p) {
+        __mmask16 mask = _mm512_cmp_ps_mask(v, p, _CMP_LT_OQ);
+        int nlt = _mm_popcnt_u32(mask);
+        _mm512_mask_compressstoreu_ps(left, mask, v);
+        _mm512_mask_compressstoreu_ps(right_end - (lanes - nlt),
+            static_cast<__mmask16>(~mask), v);
+        return nlt;
+    }
+};
+
+template <typename T>
+struct Avx512IntKernel {
+    /**
+     * Shared AVX-512 kernel for 32 and 64-bit integer keys
+     */
+    using vec = __m512i;
+    static constexpr int lanes = 64 / sizeof(T);
+    __attribute__((target("avx512f"))) static vec load(const T *p) {
+        return _mm512_loadu_si512(p);
+    }
+    __attribute__((target("avx512f"))) static void store(T *p, vec v) {
+        _mm512_storeu_si512(p, v);
+    }
+    __attribute__((target("avx512f"))) static vec set1(T x) {
+        if constexpr (sizeof(T) == 8) {
+            return _mm512_set1_epi64(x);
+        }
+        else {
+            return _mm512_set1_epi32(static_cast<std::int32_t>(x));
+        }
+    }
+    __attribute__((target("avx512f,popcnt"))) static int store_partitioned(
+        T *left, T *right_end, vec v, vec p) {
+        int nlt;
+        if constexpr (sizeof(T) == 8) {
+            __mmask8 mask = _mm512_cmplt_epi64_mask(v, p);
+            nlt = _mm_popcnt_u32(mask);
+            _mm512_mask_compressstoreu_epi64(left, mask, v);
+            _mm512_mask_compressstoreu_epi64(right_end - (lanes - nlt),
+                static_cast<__mmask8>(~mask), v);
+        }
+        else {
+            __mmask16 mask;
+            if constexpr (std::is_unsigned_v<T>) {
+                mask = _mm512_cmplt_epu32_mask(v, p);
+            }
+            else {
+                mask = _mm512_cmplt_epi32_mask(v, p);
+            }
+            nlt = _mm_popcnt_u32(mask);
+            _mm512_mask_compressstoreu_epi32(left, mask, v);
+            _mm512_mask_compressstoreu_epi32(right_end - (lanes - nlt),
+                static_cast<__mmask16>(~mask), v);
+        }
+        return nlt;
+    }
+};
+
+template <> struct Avx512Kernel<std::int64_t> : Avx512IntKernel<std::int64_t> {};
+template <> struct Avx512Kernel<std::int32_t> : Avx512IntKernel<std::int32_t> {};
+template <> struct Avx512Kernel<std::uint32_t> : Avx512IntKernel<std::uint32_t> {};
+
+template <typename K, typename T, typename Index>
+inline Index simd_partition_loop(T *a, const Index n, const T pivot) {
+    /**
+     * Partitions a[0..n) so that values less than the pivot come first
+     * One vector is kept from each end, which leaves room for full vector
+     *  stores. Each step reads the next vector from the end with less free
+     *  space and stores its partitioned lanes at both write positions
+     *
+     * Parameters:
+     *      a (T *)     :   values to partition
+     *      n (Index)   :   number of values
+     *      pivot (T)   :   value to partition around
+     *
+     * Returns:
+     *      Index   :   number of values less than the pivot
+     */
+
+    constexpr Index S = K::lanes;
+    Index left_w = 0;       // Next write position of values < pivot
+    Index right_w = n;      // One past the next write position of values >= pivot
+
+    if (n >= 2*S) {
+        const auto p = K::set1(pivot);
+        const auto first_v = K::load(a);
+        const auto last_v = K::load(a + n - S);
+        Index left_r = S;           // Next unread value from the left
+        Index right_r = n - S;      // One past the next unread value from the right
+
+        while (right_r - left_r >= S) {
+            typename K::vec v;
+            if (left_r - left_w <= right_w - right_r) {
+                v = K::load(a + left_r);
+                left_r += S;
+            }
+            else {
+                right_r -= S;
+                v = K::load(a + right_r);
+            }
+            Index nlt = K::store_partitioned(a + left_w, a + right_w, v, p);
+            left_w += nlt;
+            right_w -= S - nlt;
+        }
+
+        // The unread middle and the two saved vectors exactly fill the free
+        //  slots [left_w, right_w), finish them without branches
+        alignas(64) T rest[3*S];
+        Index k = 0;
+        for (Index i = left_r; i < right_r; i++) {
+            rest[k++] = a[i];
+        }
+        K::store(rest + k, first_v);
+        K::store(rest + k + S, last_v);
+        k += 2*S;
+        for (Index i = 0; i < k; i++) {
+            bool less = rest[i] < pivot;
+            a[left_w] = rest[i];
+            a[right_w - 1] = rest[i];
+            left_w += less;
+            right_w -= !less;
+        }
+        return left_w;
+    }
+
+    // Too small for two vectors - branchless Lomuto partition
+    for (Index i = 0; i < n; i++) {
+        T value = a[i];
+        bool less = value < pivot;
+        a[i] = a[left_w];
+        a[left_w] = value;
+        left_w += less;
+    }
+    return left_w;
+}
+
+template <typename T, typename Index>
+__attribute__((target("avx2,popcnt"), flatten))
+Index simd_partition_avx2(T *a, const Index n, const T pivot) {
+    return simd_partition_loop<Avx2Kernel<T>>(a, n, pivot);
+}
+
+template <typename T, typename Index>
+__attribute__((target("avx512f,popcnt"), flatten))
+Index simd_partition_avx512(T *a, const Index n, const T pivot) {
+    return simd_partition_loop<Avx512Kernel<T>>(a, n, pivot);
+}
+
+template <typename T, typename Index>
+__attribute__((target("avx2"), flatten))
+bool simd_sort_leaf_avx2(T *a, const Index n) {
+    return network_sort_leaf(a, n);
+}
+
+template <typename T, typename Index>
+__attribute__((target("avx512f"), flatten))
+bool simd_sort_leaf_avx512(T *a, const Index n) {
+    return network_sort_leaf(a, n);
+}
+
+#pragma GCC diagnostic pop
+
+#endif  // SIMD_PARTITION_X86
+
+template <typename T, typename Index>
+Index simd_partition(T *a, const Index n, const T pivot, const SimdLevel level) {
+    /**
+     * Partitions a[0..n) around the pivot with the given instruction set
+     *
+     * Returns:
+     *      Index   :   number of values less than the pivot
+     */
+#ifdef SIMD_PARTITION_X86
+    if (level == SimdLevel::avx512) {
+        return simd_partition_avx512(a, n, pivot);
+    }
+    if (level == SimdLevel::avx2) {
+        return simd_partition_avx2(a, n, pivot);
+    }
+#endif
+    Index m = 0;
+    for (Index i = 0; i < n; i++) {
+        T value = a[i];
+        bool less = value < pivot;
+        a[i] = a[m];
+        a[m] = value;
+        m += less;
+    }
+    return m;
+}
+
+template <typename T, typename Index>
+bool simd_sort_leaf(T *a, const Index n, const SimdLevel level) {
+    /**
+     * Sorts a leaf of at most 32 values with a sorting network compiled for
+     *  the given instruction set
+     *
+     * Returns:
+     *      bool    :   true if the leaf was sorted, false if it holds a NaN
+     *                  and must be sorted by the caller
+     */
+#ifdef SIMD_PARTITION_X86
+    if (level == SimdLevel::avx512) {
+        return simd_sort_leaf_avx512(a, n);
+    }
+    if (level == SimdLevel::avx2) {
+        return simd_sort_leaf_avx2(a, n);
+    }
+#endif
+    return network_sort_leaf(a, n);
+}
+
+#endif  // SIMD_PARTITION_H
@@ -0,0 +1,416 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     SortCache.h
+ *
+ * This header implements the sorted output cache of Azeem_Musa_QuickSort.cpp,
+ *   which skips files whose sorted output an earlier run already wrote
+ *  - Entries are sorted files named by the XXH64 hash of the input bytes
+ *    and a tag of the settings that change the output (key type, output
+ *    format, NaN policy)
+ *  - index.tsv remembers the hash of every input path with its size, inode,
+ *    mtime and ctime, so unchanged files are not read again. Other files
+ *    are memory-mapped and hashed
+ *  - A hit is hard linked into the output directory, or reflinked or copied
+ *    where the cache lives on another file system. Linked outputs share
+ *    their data with the cache, so they must not be edited in place, and a
+ *    run writing over an earlier output unlinks it first
+ *  - A miss stores a reflink or copy of the written output, never a hard
+ *    link, so a later write to the output path cannot reach the entry
+ *  - Entries and the index are written to a temporary name and renamed, so
+ *    an interrupted run never leaves a partial entry
+ */
+
+#ifndef SORT_CACHE_H
+#define SORT_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace xxh64_detail {
+    constexpr std::uint64_t p1 = 0x9e3779b185ebca87ULL;
+    constexpr std::uint64_t p2 = 0xc2b2ae3d27d4eb4fULL;
+    constexpr std::uint64_t p3 = 0x165667b19e3779f9ULL;
+    constexpr std::uint64_t p4 = 0x85ebca77c2b2ae63ULL;
+    constexpr std::uint64_t p5 = 0x27d4eb2f165667c5ULL;
+
+    inline std::uint64_t rotl(const std::uint64_t x, const int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline std::uint64_t read64(const unsigned char *p) {
+        std::uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    inline std::uint32_t read32(const unsigned char *p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    inline std::uint64_t round(std::uint64_t acc, const std::uint64_t input) {
+        acc += input * p2;
+        return rotl(acc, 31) * p1;
+    }
+
+    inline std::uint64_t merge_round(std::uint64_t acc,
+        const std::uint64_t val) {
+        acc ^= round(0, val);
+        return acc * p1 + p4;
+    }
+}
+
+inline std::uint64_t xxh64(const void *data, const std::size_t size,
+    const std::uint64_t seed = 0) {
+    /**
+     * Hashes a buffer with XXH64 (little endian hosts)
+     *
+     * Parameters:
+     *      data (void *)       :   bytes to hash
+     *      size (size_t)       :   number of bytes
+     *      seed (uint64_t)     :   seed of the hash
+     *
+     * Returns:
+     *      uint64_t    :   XXH64 of the bytes
+     */
+    using namespace xxh64_detail;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + size;
+    std::uint64_t h;
+
+    if (size >= 32) {
+        std::uint64_t v1 = seed + p1 + p2;
+        std::uint64_t v2 = seed + p2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - p1;
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    }
+    else {
+        h = seed + p5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * p1 + p4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<std::uint64_t>(read32(p)) * p1;
+        h = rotl(h, 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * p5;
+        h = rotl(h, 11) * p1;
+    }
+
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Cache lookups of the files of one input size
+struct CacheStats {
+    std::size_t files = 0;
+    std::size_t hits = 0;
+    std::size_t unchanged = 0;  // hashes taken from the index
+    double hashed_bytes = 0;
+    double hash_time = 0;       // ms
+};
+
+class SortCache {
+
+    private:
+        // What index.tsv knows about an input path
+        struct IndexEntry {
+            std::uint64_t size;
+            std::uint64_t inode;
+            std::int64_t mtime;     // ns
+            std::int64_t ctime;     // ns
+            std::uint64_t hash;
+        };
+
+        std::string dir;
+        std::string tag;
+        std::mutex mutex;
+        std::map<std::string, IndexEntry> index;
+        bool index_changed = false;
+
+        static int place(const std::string &from, const std::string &to,
+            bool hard_link);
+        std::string entry_path(const std::string &key) const;
+
+    public:
+        SortCache(const std::string &dir, const std::string &tag);
+        SortCache(const SortCache &) = delete;
+        SortCache &operator=(const SortCache &) = delete;
+
+        int open();
+        bool fetch(const std::string &in_path, const std::string &out_path,
+            std::string &key, CacheStats &stats);
+        void store(const std::string &key, const std::string &sorted_path);
+        int save_index();
+};
+
+inline SortCache::SortCache(const std::string &dir, const std::string &tag)
+    : dir(dir), tag(tag) {
+    /**
+     * Parameters:
+     *      dir (string)    :   directory of the cache
+     *      tag (string)    :   settings that change the sorted output
+     */
+}
+
+inline int SortCache::open() {
+    /**
+     * Creates the cache directory and loads its index
+     *
+     * Returns:
+     *      int :   returns 1 for success, 0 if the directory cannot be used
+     */
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (!std::filesystem::is_directory(dir, ec)) {
+        std::cerr << "Error Creating Cache Directory" << std::endl;
+        return 0;
+    }
+    std::ifstream in(dir + "/index.tsv");
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        IndexEntry e;
+        std::string path;
+        if (iss >> e.size >> e.inode >> e.mtime >> e.ctime >> std::hex
+            >> e.hash && iss.get() == '\t' && std::getline(iss, path)) {
+            index[path] = e;
+        }
+    }
+    return 1;
+}
+
+inline std::string SortCache::entry_path(const std::string &key) const {
+    /**
+     * Returns:
+     *      string  :   path of the cache entry of a key
+     */
+    return dir + "/" + key;
+}
+
+inline int SortCache::place(const std::string &from, const std::string &to,
+    bool hard_link) {
+    /**
+     * Makes "to" a file with the contents of "from" without copying them if
+     *  possible: a hard link if allowed, else a reflink, else a copy
+     *
+     * Parameters:
+     *      from (string)       :   existing file
+     *      to (string)         :   file to create
+     *      hard_link (bool)    :   false if "to" must not share its inode
+     *                              with "from"
+     *
+     * Returns:
+     *      int :   returns 1 if "to" was created, 0 if not
+     */
+    if (hard_link && link(from.c_str(), to.c_str()) == 0) {
+        return 1;
+    }
+#ifdef FICLONE
+    int src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src >= 0) {
+        int dst = ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+            0644);
+        bool cloned = dst >= 0 && ioctl(dst, FICLONE, src) == 0;
+        if (dst >= 0) {
+            close(dst);
+        }
+        close(src);
+        if (cloned) {
+            return 1;
+        }
+        if (dst >= 0) {
+            unlink(to.c_str());     // created for the clone only
+        }
+    }
+#endif
+    std::error_code ec;
+    std::filesystem::copy_file(from, to, ec);
+    return ec ? 0 : 1;
+}
+
+inline bool SortCache::fetch(const std::string &in_path,
+    const std::string &out_path, std::string &key, CacheStats &stats) {
+    /**
+     * Looks up the sorted output of an input file, and places it at
+     *  out_path on a hit
+     *
+     * Parameters:
+     *      in_path (string)        :   input file
+     *      out_path (string)       :   where the sorted file goes
+     *      key (string &)          :   set to the key to store the sorted
+     *                                  file under on a miss, or empty if the
+     *                                  input could not be hashed
+     *      stats (CacheStats &)    :   lookup counters of the input size
+     *
+     * Returns:
+     *      bool    :   true if out_path holds the cached sorted output
+     */
+    key.clear();
+    stats.files++;
+    // Indexed by absolute path, so runs from other directories share it
+    std::error_code ec;
+    const std::string path = std::filesystem::absolute(in_path, ec).string();
+    struct stat st;
+    if (ec || stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    IndexEntry e;
+    e.size = st.st_size;
+    e.inode = st.st_ino;
+    e.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000
+        + st.st_mtim.tv_nsec;
+    e.ctime = static_cast<std::int64_t>(st.st_ctim.tv_sec) * 1000000000
+        + st.st_ctim.tv_nsec;
+
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(path);
+        if (it != index.end() && it->second.size == e.size
+            && it->second.inode == e.inode && it->second.mtime == e.mtime
+            && it->second.ctime == e.ctime) {
+            e.hash = it->second.hash;
+            known = true;
+        }
+    }
+    if (known) {
+        stats.unchanged++;
+    }
+    else {
+        // Hash the mapped file
+        auto hash_start = std::chrono::steady_clock::now();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        e.hash = xxh64(nullptr, 0);
+        if (e.size > 0) {
+            void *data = mmap(nullptr, e.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+            madvise(data, e.size, MADV_SEQUENTIAL);
+            e.hash = xxh64(data, e.size);
+            munmap(data, e.size);
+        }
+        close(fd);
+        stats.hashed_bytes += e.size;
+        stats.hash_time += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - hash_start).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        index[path] = e;
+        index_changed = true;
+    }
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+        static_cast<unsigned long long>(e.hash));
+    key = std::string(hex) + "-" + tag;
+    if (access(entry_path(key).c_str(), F_OK) == 0
+        && place(entry_path(key), out_path, true)) {
+        stats.hits++;
+        return true;
+    }
+    return false;
+}
+
+inline void SortCache::store(const std::string &key,
+    const std::string &sorted_path) {
+    /**
+     * Adds a reflink or copy of a written sorted file to the cache. A
+     *  failure only costs the next run a sort, so it is not reported
+     *
+     * Parameters:
+     *      key (string)            :   key from fetch, nothing is stored if
+     *                                  it is empty
+     *      sorted_path (string)    :   sorted output of the input
+     */
+    if (key.empty()) {
+        return;
+    }
+    std::ostringstream tmp;
+    tmp << entry_path(key) << ".tmp" << getpid() << "-"
+        << std::hash<std::string>()(sorted_path);
+    std::remove(tmp.str().c_str());
+    if (place(sorted_path, tmp.str(), false)
+        && std::rename(tmp.str().c_str(), entry_path(key).c_str()) == 0) {
+        return;
+    }
+    std::remove(tmp.str().c_str());
+}
+
+inline int SortCache::save_index() {
+    /**
+     * Writes the index if a lookup hashed a file
+     *
+     * Returns:
+     *      int :   returns 1 for success
+     */
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!index_changed) {
+        return 1;
+    }
+    std::string tmp = dir + "/index.tsv.tmp" + std::to_string(getpid());
+    std::ofstream out(tmp);
+    for (const auto &m : index) {
+        const IndexEntry &e = m.second;
+        out << e.size << " " << e.inode << " " << e.mtime << " " << e.ctime
+            << " " << std::hex << e.hash << std::dec << "\t" << m.first
+            << "\n";
+    }
+    out.close();
+    if (!out || std::rename(tmp.c_str(), (dir + "/index.tsv").c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "Error Writing Cache Index" << std::endl;
+        return 0;
+    }
+    index_changed = false;
+    return 1;
+}
+
+#endif  // SORT_CACHE_H
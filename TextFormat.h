@@ -0,0 +1,130 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     TextFormat.h
+ *
+ * This header implements the ASCII file format shared by
+ *   Azeem_Musa_QuickSort.cpp and FormatConverter.cpp
+ *  - Values are separated by whitespace and parsed in place with
+ *    std::from_chars, so no locale or stream is involved. A leading '+' is
+ *    accepted like operator>> does, and a value that fails to parse is
+ *    skipped up to the next whitespace
+ *  - Values are formatted with std::to_chars in their shortest round trip
+ *    form, each followed by a space, so a file parses back to exactly the
+ *    same values
+ */
+
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+
+// Longer than the longest shortest round trip form of any value
+constexpr std::size_t text_value_max_length = 64;
+
+inline std::size_t estimate_text_values(const char *first, const char *last) {
+    /**
+     * Estimates the number of values in [first, last) from the values in
+     *  its first 64 KiB
+     *
+     * Returns:
+     *      size_t  :   estimated number of values
+     */
+    const std::size_t size = last - first;
+    const std::size_t sample = std::min<std::size_t>(size, 1 << 16);
+    std::size_t tokens = 0;
+    bool in_token = false;
+    for (std::size_t i = 0; i < sample; i++) {
+        bool space = std::isspace(static_cast<unsigned char>(first[i]));
+        tokens += (!space && !in_token);
+        in_token = !space;
+    }
+    if (sample == 0) {
+        return 0;
+    }
+    return size / sample * tokens + (size % sample) * tokens / sample;
+}
+
+template <typename T, typename Add>
+const char *parse_text_values(const char *first, const char *last,
+    const std::size_t max_values, Add add) {
+    /**
+     * Parses the whitespace separated values in [first, last)
+     *
+     * Parameters:
+     *      first (const char *)    :   start of the text
+     *      last (const char *)     :   end of the text
+     *      max_values (size_t)     :   stop after this many values
+     *      add (Add)               :   called with every parsed value
+     *
+     * Returns:
+     *      (const char *)  :   where parsing stopped, last unless max_values
+     *                          values were parsed first
+     */
+    std::size_t count = 0;
+    T value;
+    const char *p = first;
+    while (p < last && count < max_values) {
+        // Skip whitespace
+        while (p < last && std::isspace(static_cast<unsigned char>(*p))) {
+            p++;
+        }
+        if (p == last) {
+            break;
+        }
+
+        // from_chars takes no '+' sign, operator>> does
+        const char *digits = p;
+        if (*digits == '+' && digits + 1 < last && digits[1] != '-') {
+            digits++;
+        }
+        std::from_chars_result res = std::from_chars(digits, last, value);
+        if (res.ec == std::errc()) {
+            add(value);
+            count++;
+            p = res.ptr;
+        }
+        else {
+            // Invalid value, skip to the next value
+            while (p < last && !std::isspace(static_cast<unsigned char>(*p))) {
+                p++;
+            }
+        }
+    }
+    return p;
+}
+
+template <typename T>
+std::size_t format_text_values(const T *values, const std::size_t count,
+    std::size_t &next, char *buffer, const std::size_t capacity) {
+    /**
+     * Formats values starting at index next into the buffer, each followed
+     *  by a space, until the buffer is full or the values are exhausted
+     *
+     * Parameters:
+     *      values (const T *)  :   values to format
+     *      count (size_t)      :   number of values
+     *      next (size_t &)     :   index of the next value, advanced past the
+     *                              formatted values
+     *      buffer (char *)     :   buffer to format into
+     *      capacity (size_t)   :   size of the buffer
+     *
+     * Returns:
+     *      (size_t)    :   number of bytes formatted
+     */
+    char *p = buffer;
+    char *end = buffer + capacity;
+    while (next < count
+        && end - p > static_cast<long>(text_value_max_length)) {
+        p = std::to_chars(p, end, values[next]).ptr;
+        *p++ = ' ';
+        next++;
+    }
+    return p - buffer;
+}
+
+#endif  // TEXT_FORMAT_H
@@ -0,0 +1,252 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     ThreadPool.h
+ *
+ * This header implements a work-stealing thread pool used by the parallel
+ *   engines of the QuickSort class in Azeem_Musa_QuickSort.cpp
+ *  - Every thread owns a deque of tasks. It pushes and pops new tasks at the
+ *    back (newest first, so recursion stays cache friendly) while idle
+ *    threads steal from the front of other deques (oldest, largest tasks)
+ *  - Tasks are grouped in a TaskGroup. Waiting on a group runs queued tasks
+ *    instead of blocking, so tasks may spawn and wait on nested groups. A
+ *    waiter that finds nothing to run sleeps until the group finishes or a
+ *    task is queued
+ *  - A pool of n threads starts n-1 workers; the thread that waits on a
+ *    group is the n-th. Threads outside the pool submit to a shared queue
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup {
+    /**
+     * Counts the tasks of a group that have not finished yet
+     */
+    friend class ThreadPool;
+    private:
+        std::atomic<std::size_t> pending{0};
+};
+
+class ThreadPool {
+
+    private:
+        struct TaskQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        // queues[0] is shared by threads outside the pool
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;   // idle workers
+        std::condition_variable wait_cv;    // idle waiters on a group
+        std::atomic<std::size_t> queued{0};
+        std::size_t waiters = 0;            // guarded by sleep_mutex
+        bool stopping = false;
+
+        // Failed attempts to run a task before a waiter sleeps
+        static constexpr unsigned wait_spins = 64;
+
+        // Pool and queue index of the calling thread
+        static inline thread_local const ThreadPool *current_pool = nullptr;
+        static inline thread_local std::size_t current_index = 0;
+
+        void worker_loop(const std::size_t index);
+        bool try_run_one(const std::size_t index);
+        std::size_t queue_index() const;
+
+    public:
+        explicit ThreadPool(const unsigned num_threads);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        unsigned size() const;
+        void run(TaskGroup &group, std::function<void()> task);
+        void wait(TaskGroup &group);
+};
+
+inline ThreadPool::ThreadPool(const unsigned num_threads) {
+    /**
+     * Starts num_threads-1 worker threads
+     *
+     * Parameters:
+     *      num_threads (unsigned)  :   threads that run tasks, including the
+     *                                  thread that waits on a group
+     */
+    unsigned n = (num_threads == 0) ? 1 : num_threads;
+    for (unsigned i = 0; i < n; i++) {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (unsigned i = 1; i < n; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+inline ThreadPool::~ThreadPool() {
+    /**
+     * Stops and joins the worker threads
+     */
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+inline unsigned ThreadPool::size() const {
+    /**
+     * Returns:
+     *      unsigned    :   number of threads that run tasks
+     */
+    return static_cast<unsigned>(queues.size());
+}
+
+inline std::size_t ThreadPool::queue_index() const {
+    /**
+     * Returns:
+     *      size_t  :   queue owned by the calling thread, or the shared
+     *                  queue 0 for threads outside the pool
+     */
+    return (current_pool == this) ? current_index : 0;
+}
+
+inline void ThreadPool::run(TaskGroup &group, std::function<void()> task) {
+    /**
+     * Queues a task as part of the given group
+     *
+     * Parameters:
+     *      group (TaskGroup &)     :   group to add the task to
+     *      task (function)         :   work to run
+     */
+    group.pending++;
+    // Counted before it is queued, so a thread that runs it first cannot
+    //  take queued below zero
+    bool wake_waiters;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued++;
+        wake_waiters = waiters > 0;
+    }
+    TaskQueue &queue = *queues[queue_index()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back([this, task = std::move(task), &group]() {
+            task();
+            if (--group.pending == 0) {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                if (waiters > 0) {
+                    wait_cv.notify_all();
+                }
+            }
+        });
+    }
+    sleep_cv.notify_one();
+    if (wake_waiters) {
+        wait_cv.notify_all();
+    }
+}
+
+inline void ThreadPool::wait(TaskGroup &group) {
+    /**
+     * Runs queued tasks until every task of the group has finished. After
+     *  wait_spins attempts that find no task, sleeps until the group
+     *  finishes or a task is queued
+     *
+     * Parameters:
+     *      group (TaskGroup &) :   group to wait on
+     */
+    std::size_t index = queue_index();
+    unsigned spins = 0;
+    while (group.pending > 0) {
+        if (try_run_one(index)) {
+            spins = 0;
+            continue;
+        }
+        if (++spins < wait_spins) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        waiters++;
+        wait_cv.wait(lock, [this, &group]() {
+            return group.pending == 0 || queued > 0;
+        });
+        waiters--;
+        spins = 0;
+    }
+}
+
+inline bool ThreadPool::try_run_one(const std::size_t index) {
+    /**
+     * Runs the newest task of the given queue, or steals the oldest task of
+     *  another queue if it is empty
+     *
+     * Parameters:
+     *      index (size_t)  :   queue owned by the calling thread
+     *
+     * Returns:
+     *      bool    :   true if a task was run
+     */
+    std::function<void()> task;
+    for (std::size_t k = 0; k < queues.size() && !task; k++) {
+        TaskQueue &queue = *queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued--;
+    task();
+    return true;
+}
+
+inline void ThreadPool::worker_loop(const std::size_t index) {
+    /**
+     * Runs tasks on a worker thread, sleeping while no task is queued
+     *
+     * Parameters:
+     *      index (size_t)  :   queue owned by this worker
+     */
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        if (try_run_one(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(lock, [this]() { return stopping || queued > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+#endif  // THREAD_POOL_H
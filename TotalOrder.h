@@ -0,0 +1,93 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     TotalOrder.h
+ *
+ * This header implements the IEEE 754 totalOrder mode of the QuickSort class
+ *   in Azeem_Musa_QuickSort.cpp, which sorts floating point keys that may
+ *   hold NaNs, infinities and signed zeros
+ *  - total_order_key maps a value to an unsigned integer in totalOrder:
+ *    -inf < negative values < -0.0 < 0.0 < positive values < inf. It is the
+ *    radix key of RadixSort.h, and total_order_value maps it back bit for
+ *    bit
+ *  - NaNs have no place in that order that data agrees on, so NanPolicy
+ *    puts all of them first, puts them last or drops them. Kept NaNs stay
+ *    in their input order with their sign and payload
+ *  - TotalOrderLess compares two values like the mapped keys and the NaN
+ *    policy, for the merges of the external and streaming sorts
+ *
+ * Supported key types: double and float
+ */
+
+#ifndef TOTAL_ORDER_H
+#define TOTAL_ORDER_H
+
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "RadixSort.h"
+
+// Where the totalOrder mode puts NaNs
+enum class NanPolicy { first, last, drop };
+
+template <typename T>
+inline radix_bits_t<T> total_order_key(const T value) {
+    /**
+     * Parameters:
+     *      value (T)   :   floating point value that is not NaN
+     *
+     * Returns:
+     *      radix_bits_t<T> :   unsigned key in totalOrder
+     */
+    static_assert(std::is_floating_point_v<T>,
+        "totalOrder keys are defined for floating point types");
+    return radix_key(value);
+}
+
+template <typename T>
+inline T total_order_value(const radix_bits_t<T> key) {
+    /**
+     * Inverse of total_order_key: keys with the top bit set were positive
+     *  and only had the sign bit flipped, the others had every bit flipped
+     *
+     * Parameters:
+     *      key (radix_bits_t<T>)   :   key from total_order_key
+     *
+     * Returns:
+     *      T   :   the value the key was mapped from
+     */
+    using U = radix_bits_t<T>;
+    constexpr U sign_bit = U(1) << (8 * sizeof(T) - 1);
+    U bits = (key & sign_bit) ? key ^ sign_bit : ~key;
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+template <typename T, typename Compare>
+struct TotalOrderLess {
+    /**
+     * Orders values like the totalOrder mode when it is enabled, and like
+     *  Compare otherwise (or for types that are not floating point)
+     */
+    Compare comp;
+    bool enabled;
+    NanPolicy nan;
+
+    bool operator()(const T &a, const T &b) const {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (enabled) {
+                bool a_nan = std::isnan(a);
+                bool b_nan = std::isnan(b);
+                if (a_nan || b_nan) {
+                    return (nan == NanPolicy::first) ? a_nan && !b_nan
+                        : !a_nan && b_nan;
+                }
+                return total_order_key(a) < total_order_key(b);
+            }
+        }
+        return comp(a, b);
+    }
+};
+
+#endif  // TOTAL_ORDER_H
@@ -15,7 +15,8 @@ if __name__ == '__main__':
     print(df)
 
     # Plot Average Execution Time
-    plot = sns.lineplot(data=df, x='Input Size', y='Average Execution Time (ms)')
+    plot = sns.lineplot(data=df, x='Input Size', y='Average Execution Time (ms)',
+                        hue='Engine')
     plot.set_xticks(range(0, 1001, 100))
     plot.set_yticks(range(0, math.ceil(max(df['Average Execution Time (ms)']))+10, 10))
     plot.set_xlabel('Input Size')
@@ -0,0 +1,115 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     MergeSortTest.cpp
+ *
+ * This C++ program checks the stable merge sort of MergeSort.h against
+ *   std::stable_sort
+ *  - Values are key/position records ordered by their key only, so any
+ *    tie taken out of input order shows up in the positions
+ *  - Sizes cover the insertion sorted runs, the edges of every chunk count
+ *    up to 8 threads and sizes that leave an odd run out of a merge round
+ *  - Keys are random, heavy duplicates (4 distinct keys), all equal,
+ *    already sorted and reversed
+ *  - Every size is sorted on the calling thread only and on pools of 1 to
+ *    8 threads
+ *
+ * Usage: make test
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../MergeSort.h"
+#include "../Random.h"
+
+// A key and the position it had in the input
+struct Record {
+    std::uint32_t key;
+    std::uint32_t position;
+
+    bool operator==(const Record &other) const {
+        return key == other.key && position == other.position;
+    }
+};
+
+// Orders records by key only
+struct KeyOrder {
+    bool operator()(const Record &a, const Record &b) const {
+        return a.key < b.key;
+    }
+};
+
+std::vector<Record> make_input(WyRand &rng, const std::size_t n,
+    const int pattern) {
+    /**
+     * Parameters:
+     *      rng (WyRand &)  :   random generator
+     *      n (size_t)      :   number of records
+     *      pattern (int)   :   0 = random, 1 = 4 distinct keys, 2 = all
+     *                          equal, 3 = sorted, 4 = reversed
+     *
+     * Returns:
+     *      vector<Record>  :   records numbered by their position
+     */
+    std::vector<Record> records(n);
+    for (std::size_t i = 0; i < n; i++) {
+        std::uint32_t key = 0;
+        switch (pattern) {
+            case 0: key = static_cast<std::uint32_t>(rng.next()); break;
+            case 1: key = static_cast<std::uint32_t>(rng.bounded(4)); break;
+            case 2: key = 7; break;
+            case 3: key = static_cast<std::uint32_t>(i / 3); break;
+            default: key = static_cast<std::uint32_t>((n - i) / 3); break;
+        }
+        records[i] = {key, static_cast<std::uint32_t>(i)};
+    }
+    return records;
+}
+
+int main() {
+    std::vector<std::size_t> sizes = {0, 1, 2, 3, 31, 32, 33, 63, 64, 65,
+        1000, 4099};
+    for (std::size_t chunks = 2; chunks <= 8; chunks++) {
+        std::size_t edge = chunks * merge_parallel_grain;
+        sizes.insert(sizes.end(), {edge - 1, edge, edge + 1});
+    }
+    sizes.push_back(5 * merge_parallel_grain + merge_run_size * 3 + 5);
+
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    pools.push_back(nullptr);           // calling thread only
+    for (unsigned threads : {1u, 2u, 3u, 4u, 5u, 7u, 8u}) {
+        pools.push_back(std::make_unique<ThreadPool>(threads));
+    }
+
+    WyRand rng(42);
+    std::size_t checks = 0;
+    std::size_t failures = 0;
+    for (std::size_t n : sizes) {
+        for (int pattern = 0; pattern < 5; pattern++) {
+            const std::vector<Record> input = make_input(rng, n, pattern);
+            std::vector<Record> expected = input;
+            std::stable_sort(expected.begin(), expected.end(), KeyOrder());
+            for (const auto &pool : pools) {
+                std::vector<Record> data = input;
+                std::vector<Record> buffer(n);
+                parallel_merge_sort(data.data(), n, buffer.data(),
+                    KeyOrder(), pool.get());
+                checks++;
+                if (data != expected) {
+                    failures++;
+                    std::cout << "FAIL: n=" << n << " pattern=" << pattern
+                        << " threads=" << (pool ? pool->size() : 0)
+                        << std::endl;
+                }
+            }
+        }
+    }
+    std::cout << "MergeSortTest: " << checks - failures << " of " << checks
+        << " checks passed" << std::endl;
+    return (failures == 0) ? 0 : 1;
+}
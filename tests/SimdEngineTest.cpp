@@ -0,0 +1,257 @@
+/**
+ * Author :     Musa Azeem
+ * Date   :     12/2/2022
+ * File   :     SimdEngineTest.cpp
+ *
+ * This C++ program checks the "simd" engine of Azeem_Musa_QuickSort.cpp
+ *   against its scalar path (the same engine with --simd=scalar) for every
+ *   key type with a vector kernel that --type accepts
+ *  - Inputs are random, few unique and special values: -0.0, 0.0, NaNs,
+ *    infinities and the limits of the type, at every leaf size up to 40
+ *    and at larger sizes, with and without the presort scan
+ *  - Every output must keep the input values bit for bit
+ *  - Without NaNs every output must equal the scalar one value for value
+ *    (-0.0 and 0.0 compare equal, so either may come first). NaNs have no
+ *    place under operator<, so with NaNs only the values are checked
+ *  - In totalOrder mode (--total-order) every output must equal the scalar
+ *    one bit for bit, NaNs included
+ *
+ * Usage: make test
+ */
+
+#define QUICKSORT_NO_MAIN
+#include "../Azeem_Musa_QuickSort.cpp"
+
+// Checks run and checks failed
+struct TestCount {
+    std::size_t checks = 0;
+    std::size_t failures = 0;
+};
+
+template <typename T>
+std::string type_name() {
+    /**
+     * Returns:
+     *      string  :   name of T as accepted by --type
+     */
+    if constexpr (std::is_same_v<T, double>) {
+        return "double";
+    }
+    else if constexpr (std::is_same_v<T, float>) {
+        return "float";
+    }
+    else if constexpr (std::is_same_v<T, std::int64_t>) {
+        return "int64";
+    }
+    else {
+        return "uint32";
+    }
+}
+
+template <typename T>
+std::uint64_t value_bits(const T value) {
+    /**
+     * Returns:
+     *      uint64_t    :   the bits of the value, to compare values exactly
+     */
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+}
+
+template <typename T>
+std::vector<T> special_values() {
+    /**
+     * Returns:
+     *      vector<T>   :   values at the edges of the order of T
+     */
+    using L = std::numeric_limits<T>;
+    std::vector<T> values = {L::lowest(), L::max(), L::min(), T(0), T(1)};
+    if constexpr (std::is_floating_point_v<T>) {
+        values.insert(values.end(), {-T(0), L::infinity(), -L::infinity(),
+            L::quiet_NaN(), -L::quiet_NaN(), L::denorm_min(), T(-1)});
+    }
+    return values;
+}
+
+template <typename T>
+std::vector<T> make_input(WyRand &rng, const std::size_t n, const int pattern) {
+    /**
+     * Parameters:
+     *      rng (WyRand &)  :   random generator
+     *      n (size_t)      :   number of values
+     *      pattern (int)   :   0 = random, 1 = few unique, 2 = zeros of both
+     *                          signs with infinities, 3 = special values
+     *                          with NaNs
+     *
+     * Returns:
+     *      vector<T>   :   the input
+     */
+    const std::vector<T> specials = special_values<T>();
+    std::vector<T> values(n);
+    for (std::size_t i = 0; i < n; i++) {
+        T random;
+        if constexpr (std::is_floating_point_v<T>) {
+            random = static_cast<T>((rng.unit() - 0.5) * 2000);
+        }
+        else {
+            random = static_cast<T>(rng.next());
+        }
+        switch (pattern) {
+            case 0:
+                values[i] = random;
+                break;
+            case 1:
+                values[i] = static_cast<T>(rng.bounded(4));
+                break;
+            case 2:
+                if constexpr (std::is_floating_point_v<T>) {
+                    const T zeros[] = {T(0), -T(0), T(1), T(-1),
+                        std::numeric_limits<T>::infinity(),
+                        -std::numeric_limits<T>::infinity()};
+                    values[i] = zeros[rng.bounded(6)];
+                }
+                else {
+                    values[i] = static_cast<T>(rng.bounded(3));
+                }
+                break;
+            default:
+                values[i] = (rng.bounded(3) == 0) ? random
+                    : specials[rng.bounded(specials.size())];
+                break;
+        }
+    }
+    return values;
+}
+
+template <typename T>
+std::vector<T> sort_with(const std::vector<T> &input, const SimdLevel level,
+    const bool presort, const bool total_order) {
+    /**
+     * Returns:
+     *      vector<T>   :   the input sorted by the simd engine at the given
+     *                      instruction set
+     */
+    QuickSort<T> q;
+    q.set_engine(Engine::simd);
+    q.set_simd_level(level);
+    q.set_presort(presort);
+    q.set_total_order(total_order, NanPolicy::last);
+    q.set_seed(1);
+    q.set_array(input);
+    q.quick_sort();
+    return q.release_array();
+}
+
+template <typename T>
+bool same_bits_multiset(const std::vector<T> &a, const std::vector<T> &b) {
+    /**
+     * Returns:
+     *      bool    :   true if a and b hold the same values bit for bit, in
+     *                  any order
+     */
+    std::vector<std::uint64_t> x;
+    std::vector<std::uint64_t> y;
+    for (const T &v : a) {
+        x.push_back(value_bits(v));
+    }
+    for (const T &v : b) {
+        y.push_back(value_bits(v));
+    }
+    std::sort(x.begin(), x.end());
+    std::sort(y.begin(), y.end());
+    return x == y;
+}
+
+template <typename T>
+void check(TestCount &count, const bool ok, const std::string &what) {
+    count.checks++;
+    if (!ok) {
+        count.failures++;
+        std::cout << "FAIL: " << type_name<T>() << " " << what << std::endl;
+    }
+}
+
+template <typename T>
+void test_type(TestCount &count) {
+    /**
+     * Compares the simd engine at every available instruction set with its
+     *  scalar path for key type T
+     */
+    std::vector<SimdLevel> levels;
+    if (detect_simd_level() >= SimdLevel::avx2) {
+        levels.push_back(SimdLevel::avx2);
+    }
+    if (detect_simd_level() == SimdLevel::avx512) {
+        levels.push_back(SimdLevel::avx512);
+    }
+    if (levels.empty()) {
+        std::cout << "No AVX2 - " << type_name<T>()
+            << " checks the scalar path only" << std::endl;
+        levels.push_back(SimdLevel::scalar);
+    }
+
+    std::vector<std::size_t> sizes;
+    for (std::size_t n = 0; n <= 40; n++) {
+        sizes.push_back(n);
+    }
+    sizes.insert(sizes.end(), {64, 100, 1000, 4097, 100000});
+
+    WyRand rng(derive_seed(42, sizeof(T)));
+    for (std::size_t n : sizes) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            const std::vector<T> input = make_input<T>(rng, n, pattern);
+            bool has_nan = false;
+            for (const T &v : input) {
+                has_nan |= (v != v);
+            }
+            for (int presort = 0; presort < 2; presort++) {
+                const std::vector<T> scalar = sort_with(input,
+                    SimdLevel::scalar, presort, false);
+                const std::vector<T> scalar_total = sort_with(input,
+                    SimdLevel::scalar, presort, true);
+                for (SimdLevel level : levels) {
+                    std::string what = "n=" + std::to_string(n)
+                        + " pattern=" + std::to_string(pattern)
+                        + " presort=" + std::to_string(presort)
+                        + " simd=" + simd_level_name(level);
+
+                    std::vector<T> out = sort_with(input, level, presort,
+                        false);
+                    check<T>(count, same_bits_multiset(input, out),
+                        what + ": values lost or duplicated");
+                    if (!has_nan) {
+                        bool equal = out.size() == scalar.size();
+                        for (std::size_t i = 0; equal && i < out.size(); i++) {
+                            equal = !(out[i] < scalar[i])
+                                && !(scalar[i] < out[i]);
+                        }
+                        check<T>(count, equal, what + ": differs from scalar");
+                    }
+
+                    std::vector<T> total = sort_with(input, level, presort,
+                        true);
+                    bool identical = total.size() == scalar_total.size();
+                    for (std::size_t i = 0; identical && i < total.size();
+                        i++) {
+                        identical = value_bits(total[i])
+                            == value_bits(scalar_total[i]);
+                    }
+                    check<T>(count, identical,
+                        what + ": totalOrder differs from scalar");
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    TestCount count;
+    test_type<double>(count);
+    test_type<float>(count);
+    test_type<std::int64_t>(count);
+    test_type<std::uint32_t>(count);
+    std::cout << "SimdEngineTest: " << count.checks - count.failures << " of "
+        << count.checks << " checks passed" << std::endl;
+    return (count.failures == 0) ? 0 : 1;
+}